@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# references/sec, faults/sec and peak RSS of every algo over synthetic 
+# traces and numbers of frames
+# usage: ./bench.sh [refs] [frames]
+REFS=${1:-10000000}
+FRAMES=${2:-"8 16 32 64"}
+ALGOS="N l r f s c X a Y O w A P"
+MODELS="z l s p m"
+DIR=${TMPDIR:-/tmp}/mmu_bench
+
+mkdir -p ${DIR}
+if [ ! -f ${DIR}/rfile ]; then
+	tar xjf lab3_assign.tar.bz2 -O lab3_assign/rfile > ${DIR}/rfile
+fi
+
+printf "%-5s %-4s %6s %12s %12s %10s\n" model algo frames refs/sec faults/sec RSS
+for m in ${MODELS}; do
+	TRACE=${DIR}/${m}_${REFS}.bin
+	if [ ! -f ${TRACE} ]; then
+		./tracegen -m${m} -n${REFS} -b ${TRACE}
+	fi
+	for a in ${ALGOS}; do
+		for f in ${FRAMES}; do
+			./mmu -a${a} -f${f} -oT ${TRACE} ${DIR}/rfile | \
+				awk -v m=${m} -v a=${a} -v f=${f} '/^TIME/ {
+					printf "%-5s %-4s %6s %12s %12s %10s\n", m, a, f, $3, $5, $7 }'
+		done
+	done
+done
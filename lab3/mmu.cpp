@@ -4,15 +4,28 @@
 #include <vector>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "trace_format.h"
 
 using namespace std;
 
 /* 
  * page table entry(pte):
  * 
- * 0       1        2         3|4...31
- * Present Modified Reference Pagedout|addr
+ * 0       1        2         3        4|5...31
+ * Present Modified Reference Pagedout COW|addr
+ *
+ * COW (write protected, copy on write) is only used by the fork mode.
  */
 
 void set_present_bit(unsigned int& p) {
@@ -71,23 +84,251 @@ unsigned int get_pagedout_bit(unsigned int p) {
     return ((p >> 28) & 1) | 0;
 }
 
+void set_cow_bit(unsigned int& p) {
+    unsigned int mask = 0x08000000;
+    p |= mask;
+}
+
+void clear_cow_bit(unsigned int& p) {
+    unsigned int mask = 0xf7ffffff;
+    p &= mask;
+}
+
+unsigned int get_cow_bit(unsigned int p) {
+    return ((p >> 27) & 1) | 0;
+}
+
 void set_frame_number(unsigned int& p, int f) {
-    p = (p & 0xf0000000) | f;
+    p = (p & 0xf8000000) | f;
 }
 
 unsigned int get_frame_number(unsigned int p) {
-    return ((p << 4) >> 4);
+    return ((p << 5) >> 5);
+}
+
+
+/*
+ * trace records kept in memory: bit 31 is the r/w bit, the rest is the 
+ * page index
+ */
+unsigned int make_ref(unsigned int rw, unsigned int pi) {
+  return (rw << 31) | pi;
+}
+
+unsigned int get_ref_rw(unsigned int r) {
+  return r >> 31;
+}
+
+unsigned int get_ref_page(unsigned int r) {
+  return r & 0x7fffffff;
+}
+
+
+/*
+ * bit helpers for the page table bitmaps
+ */
+
+// index of the first i in [from, to) that is set in want and clear in skip,
+// or -1 if there is none
+int find_next_bit(const vector<unsigned long long>& want,
+                  const vector<unsigned long long>& skip, int from, int to) {
+  while (from < to) {
+    int w = from >> 6;
+    unsigned long long word = (want[w] & ~skip[w]) >> (from & 63);
+    if (word != 0) {
+      int i = from + __builtin_ctzll(word);
+      return i < to ? i : -1;
+    }
+    from = (w + 1) << 6;
+  }
+  return -1;
+}
+
+// index of the first i in [from, to) that is set in map, or -1
+int find_next_bit(const vector<unsigned long long>& map, int from, int to) {
+  while (from < to) {
+    int w = from >> 6;
+    unsigned long long word = map[w] >> (from & 63);
+    if (word != 0) {
+      int i = from + __builtin_ctzll(word);
+      return i < to ? i : -1;
+    }
+    from = (w + 1) << 6;
+  }
+  return -1;
+}
+
+// calls fn(i) for every bit i in [from, to) set in map; fn may clear bits
+template <class F>
+void for_each_set_bit(const vector<unsigned long long>& map, int from, int to,
+                      F fn) {
+  while (from < to) {
+    int w = from >> 6;
+    unsigned long long word = map[w] >> (from & 63) << (from & 63);
+    int end = (w + 1) << 6;
+    if (end > to) {
+      word &= ~0ULL >> (end - to);
+    }
+    while (word != 0) {
+      fn((w << 6) + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+    from = end;
+  }
 }
 
 
+/*
+ * page table, with present and referenced bitmaps kept alongside the ptes 
+ * so that the clock hands can skip 64 entries at a time. The same bits are 
+ * also kept per frame for the physical clock. All updates have to go 
+ * through the methods below to keep the bitmaps in sync.
+ */
+class PageTable {
+  private:
+    vector<unsigned int> ptes;
+
+    // one bit per page
+    vector<unsigned long long> present_map, referenced_map;
+
+    // one bit per frame, set if the frame holds a present (referenced) page
+    vector<unsigned long long> frame_present_map, frame_referenced_map;
+
+    void set_bit(vector<unsigned long long>& map, unsigned int i) {
+      map[i >> 6] |= 1ULL << (i & 63);
+    }
+
+    void clear_bit(vector<unsigned long long>& map, unsigned int i) {
+      map[i >> 6] &= ~(1ULL << (i & 63));
+    }
+
+  public:
+    PageTable(int num_of_pages, int num_of_frames) {
+      ptes = vector<unsigned int>(num_of_pages, 0);
+      present_map = vector<unsigned long long>((num_of_pages + 63) / 64, 0);
+      referenced_map = present_map;
+      frame_present_map = 
+        vector<unsigned long long>((num_of_frames + 63) / 64, 0);
+      frame_referenced_map = frame_present_map;
+    }
+
+    int size() const {
+      return ptes.size();
+    }
+
+    unsigned int operator[](int i) const {
+      return ptes[i];
+    }
+
+    const vector<unsigned int>& entries() const {
+      return ptes;
+    }
+
+    void set_present(int i) {
+      set_present_bit(ptes[i]);
+      set_bit(present_map, i);
+      set_bit(frame_present_map, get_frame_number(ptes[i]));
+      if (get_referenced_bit(ptes[i]) == 1) {
+        set_bit(frame_referenced_map, get_frame_number(ptes[i]));
+      }
+    }
+
+    void clear_present(int i) {
+      if (get_present_bit(ptes[i]) == 1) {
+        clear_bit(frame_present_map, get_frame_number(ptes[i]));
+        clear_bit(frame_referenced_map, get_frame_number(ptes[i]));
+      }
+      clear_present_bit(ptes[i]);
+      clear_bit(present_map, i);
+    }
+
+    void set_referenced(int i) {
+      set_referenced_bit(ptes[i]);
+      set_bit(referenced_map, i);
+      if (get_present_bit(ptes[i]) == 1) {
+        set_bit(frame_referenced_map, get_frame_number(ptes[i]));
+      }
+    }
+
+    void clear_referenced(int i) {
+      clear_referenced_bit(ptes[i]);
+      clear_bit(referenced_map, i);
+      if (get_present_bit(ptes[i]) == 1) {
+        clear_bit(frame_referenced_map, get_frame_number(ptes[i]));
+      }
+    }
+
+    void set_modified(int i) {
+      set_modified_bit(ptes[i]);
+    }
+
+    void clear_modified(int i) {
+      clear_modified_bit(ptes[i]);
+    }
+
+    void set_pagedout(int i) {
+      set_pagedout_bit(ptes[i]);
+    }
+
+    void set_frame(int i, int f) {
+      if (get_present_bit(ptes[i]) == 1) {
+        clear_present(i);
+        set_frame_number(ptes[i], f);
+        set_present(i);
+      }
+      else {
+        set_frame_number(ptes[i], f);
+      }
+    }
+
+    // first present page in [from, to) whose R bit is clear, or -1
+    int find_unreferenced_page(int from, int to) const {
+      return find_next_bit(present_map, referenced_map, from, to);
+    }
+
+    // first present page in [from, to), or -1
+    int find_present_page(int from, int to) const {
+      return find_next_bit(present_map, from, to);
+    }
+
+    // first frame in [from, to) holding an unreferenced page, or -1
+    int find_unreferenced_frame(int from, int to) const {
+      return find_next_bit(frame_present_map, frame_referenced_map, 
+                           from, to);
+    }
+
+    // clear the R bits of the pages in [from, to)
+    void clear_referenced_pages(int from, int to) {
+      for_each_set_bit(referenced_map, from, to, 
+                       [this](int i) { clear_referenced(i); });
+    }
+
+    // clear the R bits of the pages held by the frames in [from, to)
+    void clear_referenced_frames(int from, int to, 
+                                 const vector<unsigned int>& rev_frames) {
+      for_each_set_bit(frame_referenced_map, from, to, 
+                       [&](int f) { clear_referenced(rev_frames[f]); });
+    }
+};
+
+
 class Pager {
   protected:
     vector<int> rand_nums;
     int count_random;
     int num_of_frames;
     int ofs;
+    int vtime;
+    unsigned int curr_page;
+
+    // dirty pages the pager has written back on its own, for the VMM
+    // to account for
+    vector<unsigned int> writebacks;
 
   public:
+    virtual ~Pager() {
+    }
+
     void set_random(vector<int> r, int c) {
       rand_nums = r;
       count_random = c;
@@ -106,20 +347,37 @@ class Pager {
       num_of_frames = f;
     }
 
+    // set by the VMM before every reference: the number of instructions 
+    // executed so far and the page being referenced
+    void set_reference(int t, unsigned int pi) {
+      vtime = t;
+      curr_page = pi;
+    }
+
+    vector<unsigned int>& get_writebacks() {
+      return writebacks;
+    }
+
+    // called after every reference, with the frame the page is in
     virtual void update(vector<unsigned int>& list, unsigned int i) {
     }
 
-    virtual int get_frame(vector<unsigned int>&, 
+    // called when the VMM puts frame i, taken from get_frame, on its
+    // free list instead of mapping a page into it
+    virtual void release(vector<unsigned int>& list, unsigned int i) {
+    }
+
+    virtual int get_frame(PageTable&, 
                           vector<unsigned int>&, vector<unsigned int>&) = 0;
 
 };
 
-class Pager_NRU : public Pager {
+class Pager_NRU final : public Pager {
   private:
     // when counter ticks 10, clear all R bits
     int counter;
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames, 
                   vector<unsigned int>& rev_frames) {
 
@@ -157,18 +415,14 @@ class Pager_NRU : public Pager {
       // when ticks 10, clean all reference bits
       if (counter == 10) {
         counter = 0;
-        for (int i = 0; i < pages.size(); ++i) {
-          if (get_present_bit(pages[i]) == 1) {
-            clear_referenced_bit(pages[i]);
-          }
-        }
+        pages.clear_referenced_pages(0, pages.size());
       }
 
       return ret;
     }
 };
 
-class Pager_LRU : public Pager {
+class Pager_LRU final : public Pager {
   public:
     // LRU has its own update function
     void update(vector<unsigned int>& frames, unsigned int f) {
@@ -182,7 +436,7 @@ class Pager_LRU : public Pager {
     }
 
 
-    int get_frame(vector<unsigned int>& pages, 
+    int get_frame(PageTable& pages, 
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
       unsigned int f = frames.front();
@@ -193,19 +447,24 @@ class Pager_LRU : public Pager {
     }
 };
 
-class Pager_Random : public Pager {
+class Pager_Random final : public Pager {
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
       int r = get_random_number();
-      return frames[r % frames.size()];
+      int i = r % frames.size();
+      // skip the frames on the free list of the VMM
+      while (rev_frames[frames[i]] == -1) {
+        i = (i + 1) % frames.size();
+      }
+      return frames[i];
     }
 };
 
-class Pager_FIFO : public Pager {
+class Pager_FIFO final : public Pager {
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
 
@@ -216,9 +475,9 @@ class Pager_FIFO : public Pager {
     }
 };
 
-class Pager_SecondChance : public Pager {
+class Pager_SecondChance final : public Pager {
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
 
@@ -228,8 +487,13 @@ class Pager_SecondChance : public Pager {
       while (flag == false) {
         f = frames.front();
         pi = rev_frames[f];
-        if (get_referenced_bit(pages[pi]) == 1) {
-          clear_referenced_bit(pages[pi]);
+        if (pi == -1) {
+          // on the free list of the VMM
+          frames.erase(frames.begin());
+          frames.push_back(f);
+        } 
+        else if (get_referenced_bit(pages[pi]) == 1) {
+          pages.clear_referenced(pi);
           frames.erase(frames.begin());
           frames.push_back(f);
         } 
@@ -243,70 +507,85 @@ class Pager_SecondChance : public Pager {
     }
 };
 
-class Pager_Clock_P : public Pager {
+class Pager_Clock_P final : public Pager {
   private:
     // used to record the location
     int counter = 0;
   public:
-    int get_frame(vector<unsigned int>& pages,
+    // frames are handed out in order and never reordered by this pager,
+    // so the hand walks the frame numbers directly
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
-      bool flag = false;
-      unsigned int f, pi;
+      int n = frames.size();
 
-      while (flag == false) {
-        f = frames[counter];
-        pi = rev_frames[f];
+      int f = pages.find_unreferenced_frame(counter, n);
+      if (f == -1) {
+        f = pages.find_unreferenced_frame(0, counter);
+      }
 
-        if (get_referenced_bit(pages[pi]) == 1) {
-          clear_referenced_bit(pages[pi]);
-        } 
-        else {
-          flag = true;
-        }
-        
-        counter = (counter + 1) % frames.size();
+      if (f == -1) {
+        // every page is referenced: the hand clears all of them and
+        // stops where it started
+        f = counter;
+        pages.clear_referenced_frames(0, n, rev_frames);
+      } 
+      else if (f >= counter) {
+        pages.clear_referenced_frames(counter, f, rev_frames);
+      }
+      else {
+        pages.clear_referenced_frames(counter, n, rev_frames);
+        pages.clear_referenced_frames(0, f, rev_frames);
       }
+
+      counter = (f + 1) % n;
       return f;
     }
 };
 
-class Pager_Clock_V : public Pager {
+class Pager_Clock_V final : public Pager {
   private:
     // used to record
     int counter = 0;
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
-      bool flag = false;
-      unsigned int ret;
+      int n = pages.size();
 
-      while (flag == false) {
-        if (get_present_bit(pages[counter]) == 1) {
-           
-          if (get_referenced_bit(pages[counter]) == 1) {
-            clear_referenced_bit(pages[counter]);
-          } 
-          else {
-            flag = true;
-            ret = get_frame_number(pages[counter]);
-          }
+      int i = pages.find_unreferenced_page(counter, n);
+      if (i == -1) {
+        i = pages.find_unreferenced_page(0, counter);
+      }
+
+      if (i == -1) {
+        // every present page is referenced: the hand clears all of them
+        // and takes the first present page after where it started
+        pages.clear_referenced_pages(0, n);
+        i = pages.find_present_page(counter, n);
+        if (i == -1) {
+          i = pages.find_present_page(0, counter);
         }
-        
-        counter = (counter + 1) % pages.size();
+      } 
+      else if (i >= counter) {
+        pages.clear_referenced_pages(counter, i);
+      }
+      else {
+        pages.clear_referenced_pages(counter, n);
+        pages.clear_referenced_pages(0, i);
       }
 
-      return ret;
+      counter = (i + 1) % n;
+      return get_frame_number(pages[i]);
     }
 };
 
-class Pager_Aging_P : public Pager {
+class Pager_Aging_P final : public Pager {
   private:
     // vector to record the ages
     vector<unsigned int> ages;
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
 
@@ -319,6 +598,9 @@ class Pager_Aging_P : public Pager {
       }
 
       for (int i = 0; i < frames.size(); ++i) {
+        if (rev_frames[frames[i]] == -1) {
+          continue;
+        }
 
         ages[i] = (ages[i] >> 1) | 
           ((get_referenced_bit(pages[rev_frames[frames[i]]])) << 31);
@@ -329,7 +611,7 @@ class Pager_Aging_P : public Pager {
           min_index = i;
         }
 
-        clear_referenced_bit(pages[rev_frames[frames[i]]]);
+        pages.clear_referenced(rev_frames[frames[i]]);
 
       }
       
@@ -339,12 +621,12 @@ class Pager_Aging_P : public Pager {
     }
 };
 
-class Pager_Aging_V : public Pager {
+class Pager_Aging_V final : public Pager {
   private:
     // vector to record the ages
     vector<unsigned int> ages;
   public:
-    int get_frame(vector<unsigned int>& pages,
+    int get_frame(PageTable& pages,
                   vector<unsigned int>& frames,
                   vector<unsigned int>& rev_frames) {
 
@@ -365,7 +647,7 @@ class Pager_Aging_V : public Pager {
         }
 
         if (get_present_bit(pages[i]) == 1) {
-          clear_referenced_bit(pages[i]);
+          pages.clear_referenced(i);
         }
       }
       
@@ -376,331 +658,3845 @@ class Pager_Aging_V : public Pager {
 };
 
 
-class VMM {
+// next use of a page that is not referenced again
+const unsigned int NEVER = 0xffffffff;
+
+class Pager_OPT final : public Pager {
   private:
-   
-    unsigned int frame_limit; // max no. of frames
-    
-    vector<unsigned int> frames; // frame list
+    // position of the next reference to the same page, for every 
+    // reference of the trace
+    vector<unsigned int> next_use;
+
+    // max heap of the frames, keyed on the next use of their page
+    vector<unsigned int> heap;
+    vector<int> heap_pos;
+    vector<unsigned int> key;
+
+    void swap_nodes(int i, int j) {
+      swap(heap[i], heap[j]);
+      heap_pos[heap[i]] = i;
+      heap_pos[heap[j]] = j;
+    }
 
-    vector<unsigned int> rev_frames; // frame table
-   
-    vector<unsigned int> pages; // page table
+    void sift_up(int i) {
+      while (i > 0 && key[heap[(i - 1) / 2]] < key[heap[i]]) {
+        swap_nodes(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+      }
+    }
 
-    int cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero; // counters
+    void sift_down(int i) {
+      while (true) {
+        int m = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < heap.size() && key[heap[l]] > key[heap[m]]) {
+          m = l;
+        }
+        if (r < heap.size() && key[heap[r]] > key[heap[m]]) {
+          m = r;
+        }
+        if (m == i) {
+          break;
+        }
+        swap_nodes(i, m);
+        i = m;
+      }
+    }
 
-    Pager* algo; // page replacement algo
+  public:
+    // backward pass over the trace to find the next uses
+    void set_trace(const vector<unsigned int>& refs) {
+      unsigned int num_of_pages = 0;
+      for (size_t i = 0; i < refs.size(); ++i) {
+        num_of_pages = max(num_of_pages, get_ref_page(refs[i]) + 1);
+      }
 
-    bool O, P, F, S, p, f, a;
+      vector<unsigned int> seen(num_of_pages, NEVER);
+      next_use = vector<unsigned int>(refs.size());
+      for (size_t i = refs.size(); i-- > 0; ) {
+        unsigned int pi = get_ref_page(refs[i]);
+        next_use[i] = seen[pi];
+        seen[pi] = i;
+      }
+    }
 
-  public:
-    VMM(Pager* in_algo, unsigned int num_of_frames, bool iO, bool iP, 
-        bool iF, bool iS, bool ip, bool iif, bool ia) {
+    void update(vector<unsigned int>& frames, unsigned int f) {
+      if (heap_pos.size() <= f) {
+        heap_pos.resize(f + 1, -1);
+        key.resize(f + 1, 0);
+      }
 
-      frame_limit = num_of_frames;
+      key[f] = next_use[vtime];
+      if (heap_pos[f] == -1) {
+        heap.push_back(f);
+        heap_pos[f] = heap.size() - 1;
+        sift_up(heap.size() - 1);
+      } 
+      else {
+        sift_up(heap_pos[f]);
+        sift_down(heap_pos[f]);
+      }
+    }
 
-      cnt_inst = cnt_unmap = cnt_map = cnt_in = cnt_out = cnt_zero = 0;
+    void release(vector<unsigned int>& frames, unsigned int f) {
+      int i = heap_pos[f];
+      swap_nodes(i, heap.size() - 1);
+      heap.pop_back();
+      heap_pos[f] = -1;
+      if (i < heap.size()) {
+        sift_up(i);
+        sift_down(i);
+      }
+    }
 
-      algo = in_algo;
+    // the frame whose page is used again furthest in the future
+    int get_frame(PageTable& pages,
+                  vector<unsigned int>& frames,
+                  vector<unsigned int>& rev_frames) {
+      return heap[0];
+    }
+};
 
-      O = iO; P = iP; F = iF; S = iS;
-      p = ip; f = iif, a = ia;
 
-      pages = vector<unsigned int>(64, 0);
+/*
+ * WSClock: a page is in the working set if it was used in the last tau
+ * instructions. The hand takes the first clean page outside of the 
+ * working set. Dirty pages outside of it are written back on the way 
+ * instead of being evicted, and are taken on the second lap once clean.
+ */
+class Pager_WSClock final : public Pager {
+  private:
+    int counter = 0;
+    int tau;
+    // time of the last reference to the page in each frame
+    vector<int> last_use;
 
-      rev_frames = vector<unsigned int>(num_of_frames, -1);
+  public:
+    Pager_WSClock(int t) {
+      tau = t;
+    }
 
+    void update(vector<unsigned int>& frames, unsigned int f) {
+      if (last_use.size() <= f) {
+        last_use.resize(f + 1, 0);
+      }
+      last_use[f] = vtime;
     }
 
+    // frames are handed out in order, so the hand walks frame numbers
+    int get_frame(PageTable& pages,
+                  vector<unsigned int>& frames,
+                  vector<unsigned int>& rev_frames) {
+      int n = frames.size();
+      int clean = -1;
+      bool scheduled = false;
+
+      for (int k = 0; k < 2 * n; ++k) {
+        // a second lap only helps if it can take a page written back 
+        // on the first one
+        if (k == n && !scheduled) {
+          break;
+        }
 
-    void map_page_frame(unsigned int rw, unsigned int pi) {
-      unsigned int& pte = pages[pi];
+        int f = counter;
+        unsigned int pi = rev_frames[f];
+        counter = (counter + 1) % n;
 
-      if (O) {
-        printf("==> inst: %d %d\n", rw, pi);
+        if (pi == -1) {
+          continue;
+        }
+        if (get_referenced_bit(pages[pi]) == 1) {
+          pages.clear_referenced(pi);
+          continue;
+        }
+        if (clean == -1 && get_modified_bit(pages[pi]) == 0) {
+          clean = f;
+        }
+        if (vtime - last_use[f] <= tau) {
+          continue;
+        }
+
+        if (get_modified_bit(pages[pi]) == 0) {
+          return f;
+        }
+        // schedule the write back and move on
+        pages.clear_modified(pi);
+        pages.set_pagedout(pi);
+        writebacks.push_back(pi);
+        scheduled = true;
       }
-      // has not been mapped 
-      if (get_present_bit(pte) == 0) {
 
-        unsigned int frame_number;
-        // still free frame available
-        if (frames.size() < frame_limit) {
-          frame_number = frames.size();
+      // the whole working set is in memory: any clean page, or else the
+      // page under the hand
+      if (clean == -1) {
+        clean = counter;
+      }
+      counter = (clean + 1) % n;
+      return clean;
+    }
+};
 
-          set_frame_number(pte, frame_number);
 
-          if (O) {
-            printf("%d: ZERO     %4d\n", cnt_inst, frame_number);
-            printf("%d: MAP  %4d%4d\n", cnt_inst, pi, frame_number);
-          }
+/*
+ * doubly linked lists of pages, indexed by page number. Every page is on
+ * at most one list. Lists are kept MRU first.
+ */
+class PageLists {
+  private:
+    vector<int> prev, next, list_of;
+    vector<int> head, tail, count;
 
-          ++cnt_zero;
-          ++cnt_map;
+  public:
+    enum { NONE = -1 };
 
-          frames.push_back(frame_number);
+    PageLists(int num_of_lists) {
+      head = vector<int>(num_of_lists, -1);
+      tail = head;
+      count = vector<int>(num_of_lists, 0);
+    }
 
-          rev_frames[frame_number] = pi;
+    int size(int l) const {
+      return count[l];
+    }
 
-          
-        } // have to replace a frame
-        else {
-          frame_number = algo->get_frame(pages, frames, rev_frames);
+    int list(unsigned int pi) {
+      if (pi >= list_of.size()) {
+        return NONE;
+      }
+      return list_of[pi];
+    }
 
-          unsigned int prev_pi = rev_frames[frame_number];
+    int lru(int l) const {
+      return tail[l];
+    }
 
-          unsigned int& prev_pte = pages[prev_pi];
+    void remove(unsigned int pi) {
+      int l = list_of[pi];
+      if (prev[pi] != -1) {
+        next[prev[pi]] = next[pi];
+      } 
+      else {
+        head[l] = next[pi];
+      }
+      if (next[pi] != -1) {
+        prev[next[pi]] = prev[pi];
+      } 
+      else {
+        tail[l] = prev[pi];
+      }
+      --count[l];
+      list_of[pi] = NONE;
+    }
 
-          if (O) {
-            printf("%d: UNMAP%4d%4d\n", cnt_inst, prev_pi, 
-                frame_number);
-          }
-          ++cnt_unmap;
+    // move page pi to the MRU end of list l
+    void push(int l, unsigned int pi) {
+      if (pi >= list_of.size()) {
+        prev.resize(pi + 1, -1);
+        next.resize(pi + 1, -1);
+        list_of.resize(pi + 1, NONE);
+      }
+      if (list_of[pi] != NONE) {
+        remove(pi);
+      }
+      prev[pi] = -1;
+      next[pi] = head[l];
+      if (head[l] != -1) {
+        prev[head[l]] = pi;
+      } 
+      else {
+        tail[l] = pi;
+      }
+      head[l] = pi;
+      ++count[l];
+      list_of[pi] = l;
+    }
+};
 
-          clear_present_bit(prev_pte);
-          clear_referenced_bit(prev_pte);
 
-          if (get_modified_bit(prev_pte) == 1) {
+/*
+ * ARC: resident pages seen once (T1) or more (T2), and ghost lists of
+ * the pages recently evicted from them (B1, B2). A hit in a ghost list
+ * moves the target size p of T1 towards the list that would have kept
+ * the page.
+ */
+class Pager_ARC final : public Pager {
+  private:
+    enum { T1, T2, B1, B2 };
+    PageLists lists;
+    int p;
+    // the reference (and page, as readahead shares the instruction) whose 
+    // miss has been accounted for
+    int adapted;
+    unsigned int adapted_page;
+
+    // adapt p and trim the ghost lists for a miss on curr_page, once 
+    // per reference
+    void adapt() {
+      if (adapted == vtime && adapted_page == curr_page) {
+        return;
+      }
+      adapted = vtime;
+      adapted_page = curr_page;
+
+      int c = num_of_frames;
+      int l = lists.list(curr_page);
+      if (l == B1) {
+        p = min(c, p + max(lists.size(B2) / lists.size(B1), 1));
+      } 
+      else if (l == B2) {
+        p = max(0, p - max(lists.size(B1) / lists.size(B2), 1));
+      } 
+      else if (lists.size(T1) + lists.size(B1) == c) {
+        if (lists.size(T1) < c) {
+          lists.remove(lists.lru(B1));
+        }
+      } 
+      else if (lists.size(T1) + lists.size(T2) + lists.size(B1) + 
+               lists.size(B2) >= 2 * c) {
+        lists.remove(lists.lru(B2));
+      }
+    }
 
-            clear_modified_bit(prev_pte);
-            set_pagedout_bit(prev_pte);
+  public:
+    Pager_ARC() : lists(4) {
+      p = 0;
+      adapted = -1;
+    }
 
-            if (O) {
-              printf("%d: OUT  %4d%4d\n", cnt_inst, prev_pi, 
-                  frame_number);
-            }
-            ++cnt_out;
-          }
+    void update(vector<unsigned int>& frames, unsigned int f) {
+      int l = lists.list(curr_page);
+      if (l == T1 || l == T2 || l == B1 || l == B2) {
+        if (l == B1 || l == B2) {
+          adapt();
+        }
+        lists.push(T2, curr_page);
+      } 
+      else {
+        adapt();
+        lists.push(T1, curr_page);
+      }
+    }
 
-          if (get_pagedout_bit(pte) == 1) {
+    int get_frame(PageTable& pages,
+                  vector<unsigned int>& frames,
+                  vector<unsigned int>& rev_frames) {
+      // kswapd also asks for frames while curr_page is resident: that is
+      // no miss, so p and the ghost lists stay as they are
+      int l = lists.list(curr_page);
+      bool miss = l != T1 && l != T2;
+      if (miss) {
+        adapt();
+      }
 
-            if (O) {
-              printf("%d: IN   %4d%4d\n", cnt_inst, pi, frame_number);
-            }
-            ++cnt_in;
+      int victim;
+      if (miss && l != B1 && l != B2 && lists.size(T1) == num_of_frames) {
+        // T1 alone fills the cache and B1 is empty: drop its LRU page
+        victim = lists.lru(T1);
+        lists.remove(victim);
+      }
+      else if (lists.size(T1) >= 1 && 
+               ((l == B2 && lists.size(T1) == p) || lists.size(T1) > p ||
+                lists.size(T2) == 0)) {
+        victim = lists.lru(T1);
+        lists.push(B1, victim);
+      } 
+      else {
+        victim = lists.lru(T2);
+        lists.push(B2, victim);
+      }
+      return get_frame_number(pages[victim]);
+    }
+};
+
+
+/*
+ * CLOCK-Pro: one clock of resident pages and of non-resident cold pages
+ * still in their test period. Cold pages re-referenced during their test
+ * period become hot. HAND_cold evicts cold pages, HAND_hot turns hot 
+ * pages cold and ends test periods, HAND_test ends test periods to bound
+ * the non-resident pages to the number of frames. The cold target mc 
+ * grows when a non-resident page is referenced in its test period and 
+ * shrinks when a test period ends without one.
+ */
+class Pager_ClockPro final : public Pager {
+  private:
+    // circular list of pages, new pages go in just behind HAND_hot
+    vector<int> prev, next;
+    vector<bool> in_list, resident, hot, test, ref;
+    int hand_hot, hand_cold, hand_test;
+    int cnt_hot, cnt_cold, cnt_nonresident;
+    int mc;
+
+    void ensure(unsigned int pi) {
+      if (pi >= in_list.size()) {
+        prev.resize(pi + 1, -1);
+        next.resize(pi + 1, -1);
+        in_list.resize(pi + 1, false);
+        resident.resize(pi + 1, false);
+        hot.resize(pi + 1, false);
+        test.resize(pi + 1, false);
+        ref.resize(pi + 1, false);
+      }
+    }
+
+    void insert_head(int pi) {
+      in_list[pi] = true;
+      if (hand_hot == -1) {
+        prev[pi] = next[pi] = pi;
+        hand_hot = hand_cold = hand_test = pi;
+        return;
+      }
+      next[pi] = hand_hot;
+      prev[pi] = prev[hand_hot];
+      next[prev[hand_hot]] = pi;
+      prev[hand_hot] = pi;
+    }
+
+    void unlink(int pi) {
+      in_list[pi] = false;
+      if (next[pi] == pi) {
+        hand_hot = hand_cold = hand_test = -1;
+        return;
+      }
+      if (hand_hot == pi) hand_hot = next[pi];
+      if (hand_cold == pi) hand_cold = next[pi];
+      if (hand_test == pi) hand_test = next[pi];
+      next[prev[pi]] = next[pi];
+      prev[next[pi]] = prev[pi];
+    }
+
+    void end_test(int pi) {
+      test[pi] = false;
+      mc = max(mc - 1, 1);
+      if (!resident[pi]) {
+        unlink(pi);
+        --cnt_nonresident;
+      }
+    }
+
+    // turn one hot page cold
+    void run_hand_hot() {
+      while (cnt_hot > 0) {
+        int pi = hand_hot;
+        hand_hot = next[pi];
+        if (hot[pi]) {
+          if (ref[pi]) {
+            ref[pi] = false;
+          } 
+          else {
+            hot[pi] = false;
+            --cnt_hot;
+            ++cnt_cold;
+            return;
+          }
+        } 
+        else if (test[pi]) {
+          end_test(pi);
+        }
+      }
+    }
+
+    // drop one non-resident page
+    void run_hand_test() {
+      while (cnt_nonresident > 0) {
+        int pi = hand_test;
+        hand_test = next[pi];
+        if (!hot[pi] && test[pi]) {
+          bool drop = !resident[pi];
+          end_test(pi);
+          if (drop) {
+            return;
+          }
+        }
+      }
+    }
+
+    void balance() {
+      while (cnt_hot > num_of_frames - mc) {
+        run_hand_hot();
+      }
+      while (cnt_nonresident > num_of_frames) {
+        run_hand_test();
+      }
+    }
+
+  public:
+    Pager_ClockPro() {
+      hand_hot = hand_cold = hand_test = -1;
+      cnt_hot = cnt_cold = cnt_nonresident = 0;
+      mc = -1;
+    }
+
+    void update(vector<unsigned int>& frames, unsigned int f) {
+      int pi = curr_page;
+      ensure(pi);
+      if (mc == -1) {
+        mc = num_of_frames;
+      }
+
+      if (resident[pi]) {
+        ref[pi] = true;
+        return;
+      }
+
+      resident[pi] = true;
+      ref[pi] = false;
+      if (in_list[pi]) {
+        // referenced in its test period while out of memory
+        --cnt_nonresident;
+        unlink(pi);
+        mc = min(mc + 1, num_of_frames);
+        hot[pi] = true;
+        test[pi] = false;
+        ++cnt_hot;
+      } 
+      else {
+        hot[pi] = false;
+        test[pi] = true;
+        ++cnt_cold;
+      }
+      insert_head(pi);
+      balance();
+    }
+
+    int get_frame(PageTable& pages,
+                  vector<unsigned int>& frames,
+                  vector<unsigned int>& rev_frames) {
+      while (true) {
+        // with frames on the free list of the VMM all resident pages may
+        // be hot
+        if (cnt_cold == 0) {
+          run_hand_hot();
+        }
+        int pi = hand_cold;
+        hand_cold = next[pi];
+        if (hot[pi] || !resident[pi]) {
+          continue;
+        }
+
+        if (ref[pi]) {
+          ref[pi] = false;
+          if (test[pi]) {
+            hot[pi] = true;
+            test[pi] = false;
+            --cnt_cold;
+            ++cnt_hot;
+            balance();
           } 
           else {
+            test[pi] = true;
+            unlink(pi);
+            insert_head(pi);
+          }
+          continue;
+        }
+
+        // evict it, keeping it around while its test period lasts
+        resident[pi] = false;
+        --cnt_cold;
+        if (test[pi]) {
+          ++cnt_nonresident;
+          balance();
+        } 
+        else {
+          unlink(pi);
+        }
+        return get_frame_number(pages[pi]);
+      }
+    }
+};
+
+
+/*
+ * calls run(pager) with a new pager selected by the -a option (letter and 
+ * parameters). run has a template operator(), so that the VMM is compiled
+ * for every type of pager and its calls to the pager are inlined. run 
+ * owns the pager. Returns false if there is no such pager.
+ */
+template <class F>
+bool with_pager(char algo, const char* args, F& run) {
+  switch (algo) {
+    case 'N': run(new Pager_NRU()); break;
+    case 'l': run(new Pager_LRU()); break;
+    case 'r': run(new Pager_Random()); break;
+    case 'f': run(new Pager_FIFO()); break;
+    case 's': run(new Pager_SecondChance()); break;
+    case 'c': run(new Pager_Clock_P()); break;
+    case 'X': run(new Pager_Clock_V()); break;
+    case 'a': run(new Pager_Aging_P()); break;
+    case 'Y': run(new Pager_Aging_V()); break;
+    case 'O': run(new Pager_OPT()); break;
+    case 'A': run(new Pager_ARC()); break;
+    case 'P': run(new Pager_ClockPro()); break;
+    case 'w': run(new Pager_WSClock(*args != '\0' ? atoi(args) : 50)); break;
+    default: return false;
+  }
+  return true;
+}
+
+class KeepPager {
+  public:
+    Pager* pager;
+
+    KeepPager() {
+      pager = NULL;
+    }
+
+    template <class Algo>
+    void operator()(Algo* algo) {
+      pager = algo;
+    }
+};
+
+// page replacement algorithm selected by the -a option, NULL if there is
+// none
+Pager* new_pager(char algo, const char* args) {
+  KeepPager keep;
+  with_pager(algo, args, keep);
+  return keep.pager;
+}
+
+// OPT needs the whole trace before the run
+bool needs_trace(Pager* algo) {
+  return false;
+}
+
+bool needs_trace(Pager_OPT* algo) {
+  return true;
+}
+
+void set_trace(Pager* algo, const vector<unsigned int>& refs) {
+}
+
+void set_trace(Pager_OPT* algo, const vector<unsigned int>& refs) {
+  algo->set_trace(refs);
+}
+
+
+/*
+ * weights of the cost of a run. A cost model file (-C) can change any of
+ * them, one "<name> <value>" per line, # for comments. With swap_depth 
+ * set, IN and OUT also queue on the swap device (see SwapDevice).
+ */
+class CostModel {
+  public:
+    long long inst, map, unmap, in, out, zero;
+    long long prefetch_in; // read in by readahead, batched with the IN
+    long long tlb_l2, tlb_walk; // translations missing the TLB L1
+    long long zswap_out, zswap_in; // compressing, decompressing a page
+    long long numa_hop; // per reference and hop to the node of its frame
+    long long numa_migrate; // an UNMAP and a MAP around a page copy
+    long long copy; // copy on write
+    // swap device: latency of an I/O, time a page takes on the link
+    // (the page size over the bandwidth), I/Os in flight at most
+    long long swap_latency, swap_transfer, swap_depth;
+
+    CostModel() {
+      inst = 1;
+      map = unmap = 400;
+      in = out = 3000;
+      zero = 150;
+      prefetch_in = 1000;
+      tlb_l2 = 5;
+      tlb_walk = 30;
+      zswap_out = 500;
+      zswap_in = 300;
+      numa_hop = 1;
+      numa_migrate = 1100;
+      copy = 300;
+      swap_latency = 2000;
+      swap_transfer = 1000;
+      swap_depth = 0;
+    }
+
+    bool load(const char* name) {
+      struct {
+        const char* name;
+        long long* value;
+      } fields[] = {
+        {"inst", &inst}, {"map", &map}, {"unmap", &unmap}, {"in", &in},
+        {"out", &out}, {"zero", &zero}, {"prefetch_in", &prefetch_in},
+        {"tlb_l2", &tlb_l2}, {"tlb_walk", &tlb_walk}, 
+        {"zswap_out", &zswap_out}, {"zswap_in", &zswap_in}, 
+        {"numa_hop", &numa_hop}, {"numa_migrate", &numa_migrate}, 
+        {"copy", &copy}, {"swap_latency", &swap_latency}, 
+        {"swap_transfer", &swap_transfer}, {"swap_depth", &swap_depth}
+      };
+      int num_of_fields = sizeof(fields) / sizeof(fields[0]);
+
+      ifstream fin(name);
+      if (!fin) {
+        fprintf(stderr, "Unable to open cost model %s\n", name);
+        return false;
+      }
+      string line;
+      while (getline(fin, line)) {
+        char key[64];
+        long long value;
+        if (line.empty() || line[0] == '#' || 
+            sscanf(line.c_str(), "%63s", key) != 1) {
+          continue;
+        }
+        if (sscanf(line.c_str(), "%*s %lld", &value) != 1 || value < 0) {
+          fprintf(stderr, "Invalid cost %s\n", line.c_str());
+          return false;
+        }
+        int i = 0;
+        while (i < num_of_fields && strcmp(fields[i].name, key) != 0) {
+          ++i;
+        }
+        if (i == num_of_fields) {
+          fprintf(stderr, "Unknown cost %s\n", key);
+          return false;
+        }
+        *fields[i].value = value;
+      }
+      return true;
+    }
+};
+
+CostModel cost_model;
+
+// weighted cost of a run as reported in the SUM line
+unsigned long long get_cost(long long inst, long long unmap, long long map,
+                            long long in, long long out, long long zero) {
+  return cost_model.inst * inst + cost_model.map * map + 
+         cost_model.unmap * unmap + cost_model.in * in + 
+         cost_model.out * out + cost_model.zero * zero;
+}
+
+/*
+ * swap device with swap_depth I/Os in flight. An I/O waits for a free 
+ * slot, takes swap_latency, then waits for the link, which moves one page
+ * at a time in swap_transfer. The VMM advances a wall clock: the weighted
+ * cost of the work done so far plus the time spent waiting for the 
+ * device, on the demand IN and the OUTs of its fault and on the pages 
+ * still being read ahead. The other work of the fault (UNMAP, MAP) 
+ * overlaps its I/Os, and OUTs of kswapd and of the pagers don't block.
+ */
+class SwapDevice {
+  private:
+    vector<long long> slots; // time every slot is free again
+    long long link_free;
+    long long cnt_io, sum_latency;
+
+  public:
+    SwapDevice() {
+      slots = vector<long long>(cost_model.swap_depth, 0);
+      link_free = 0;
+      cnt_io = sum_latency = 0;
+    }
+
+    // time an I/O issued at now completes
+    long long submit(long long now) {
+      int s = min_element(slots.begin(), slots.end()) - slots.begin();
+      long long start = max(now, slots[s]);
+      long long done = max(start + cost_model.swap_latency, link_free) + 
+                       cost_model.swap_transfer;
+      link_free = done;
+      slots[s] = done;
+      ++cnt_io;
+      sum_latency += done - now;
+      return done;
+    }
+
+    long long get_num_of_ios() const {
+      return cnt_io;
+    }
+
+    double get_avg_latency() const {
+      return cnt_io == 0 ? 0.0 : (double)sum_latency / cnt_io;
+    }
+};
+
+/*
+ * one level of a set associative TLB. Entries hold page numbers; a page
+ * can only live in set (page % number of sets). Replacement within a
+ * set is LRU, FIFO or random.
+ */
+class TLBLevel {
+  private:
+    int num_of_sets, ways;
+    char policy;
+    vector<int> tags; // page of each entry, or -1
+    vector<unsigned long long> stamps; // last use (LRU) or fill (FIFO)
+    vector<int> slot_of; // entry of each page, or -1
+    unsigned long long clock;
+    unsigned int seed;
+
+  public:
+    long long hits, misses;
+
+    TLBLevel(int entries, int w, char p) {
+      ways = w;
+      num_of_sets = entries / w;
+      policy = p;
+      tags = vector<int>(entries, -1);
+      stamps = vector<unsigned long long>(entries, 0);
+      clock = 0;
+      seed = 2463534242u;
+      hits = misses = 0;
+    }
+
+    int get_entries() const {
+      return tags.size();
+    }
+
+    int get_ways() const {
+      return ways;
+    }
+
+    char get_policy() const {
+      return policy;
+    }
+
+    bool lookup(unsigned int pi) {
+      ++clock;
+      if (pi < slot_of.size() && slot_of[pi] != -1) {
+        if (policy == 'l') {
+          stamps[slot_of[pi]] = clock;
+        }
+        ++hits;
+        return true;
+      }
+      ++misses;
+      return false;
+    }
+
+    void fill(unsigned int pi) {
+      if (pi >= slot_of.size()) {
+        slot_of.resize(pi + 1, -1);
+      }
+      if (slot_of[pi] != -1) {
+        return;
+      }
+
+      int first = (pi % num_of_sets) * ways;
+      int victim = -1;
+      for (int i = first; i < first + ways; ++i) {
+        if (tags[i] == -1) {
+          victim = i;
+          break;
+        }
+      }
+      if (victim == -1) {
+        if (policy == 'r') {
+          // xorshift, so the rfile is left to the pager
+          seed ^= seed << 13;
+          seed ^= seed >> 17;
+          seed ^= seed << 5;
+          victim = first + seed % ways;
+        } 
+        else {
+          victim = first;
+          for (int i = first + 1; i < first + ways; ++i) {
+            if (stamps[i] < stamps[victim]) {
+              victim = i;
+            }
+          }
+        }
+        slot_of[tags[victim]] = -1;
+      }
+
+      tags[victim] = pi;
+      stamps[victim] = clock;
+      slot_of[pi] = victim;
+    }
+
+    // shootdown of the entry of an unmapped page
+    bool invalidate(unsigned int pi) {
+      if (pi >= slot_of.size() || slot_of[pi] == -1) {
+        return false;
+      }
+      tags[slot_of[pi]] = -1;
+      slot_of[pi] = -1;
+      return true;
+    }
+};
+
+
+/*
+ * a TLB with one or two levels in front of the page table. A miss in
+ * the first level looks up the second one, and a miss in the last level
+ * walks the page table. Both levels are filled on the way back.
+ */
+class TLB {
+  private:
+    vector<TLBLevel> levels;
+    long long walks, shootdowns;
+    unsigned long long cost;
+
+  public:
+    TLB() {
+      walks = shootdowns = 0;
+      cost = 0;
+    }
+
+    void add_level(int entries, int ways, char policy) {
+      levels.push_back(TLBLevel(entries, ways, policy));
+    }
+
+    void translate(unsigned int pi) {
+      int l = 0;
+      while (l < levels.size() && !levels[l].lookup(pi)) {
+        ++l;
+      }
+      if (l == levels.size()) {
+        ++walks;
+        cost += cost_model.tlb_walk;
+      } 
+      else if (l > 0) {
+        cost += cost_model.tlb_l2;
+      }
+      for (int i = 0; i < l && i < levels.size(); ++i) {
+        levels[i].fill(pi);
+      }
+    }
+
+    void shootdown(unsigned int pi) {
+      bool found = false;
+      for (int i = 0; i < levels.size(); ++i) {
+        found |= levels[i].invalidate(pi);
+      }
+      if (found) {
+        ++shootdowns;
+      }
+    }
+
+    unsigned long long get_cost() const {
+      return cost;
+    }
+
+    void print_summary() {
+      for (int i = 0; i < levels.size(); ++i) {
+        TLBLevel& t = levels[i];
+        long long n = t.hits + t.misses;
+        printf("TLB L%d %d/%d %s: hits=%lld misses=%lld (%.2lf%%)\n", 
+               i + 1, t.get_entries(), t.get_ways(), 
+               t.get_policy() == 'l' ? "lru" : 
+               t.get_policy() == 'f' ? "fifo" : "random", 
+               t.hits, t.misses, n == 0 ? 0.0 : 100.0 * t.hits / n);
+      }
+      printf("TLB walks=%lld shootdowns=%lld ===> %llu\n", walks, 
+             shootdowns, cost);
+    }
+};
+
+// parse a TLB like "64:4:l" or "16:4:l,512:8:r" (entries:ways:policy per
+// level, ways default to fully associative and policy to LRU)
+TLB* new_tlb(const char* s) {
+  TLB* tlb = new TLB();
+  int num_of_levels = 0;
+  while (*s != '\0') {
+    int entries, ways, n = 0;
+    char policy = 'l';
+    if (sscanf(s, "%d%n", &entries, &n) != 1) {
+      delete tlb;
+      return NULL;
+    }
+    s += n;
+    ways = entries;
+    if (*s == ':') {
+      if (sscanf(s + 1, "%d%n", &ways, &n) != 1) {
+        delete tlb;
+        return NULL;
+      }
+      s += n + 1;
+      if (*s == ':' && s[1] != '\0') {
+        policy = s[1];
+        s += 2;
+      }
+    }
+    if (entries < 1 || ways < 1 || entries % ways != 0 ||
+        strchr("lfr", policy) == NULL || ++num_of_levels > 2) {
+      delete tlb;
+      return NULL;
+    }
+    tlb->add_level(entries, ways, policy);
+    if (*s == ',') {
+      ++s;
+    } 
+    else if (*s != '\0') {
+      delete tlb;
+      return NULL;
+    }
+  }
+  if (num_of_levels == 0) {
+    delete tlb;
+    return NULL;
+  }
+  return tlb;
+}
+
+const int PAGE_BYTES = 4096;
+
+/*
+ * zswap: a pool of compressed pages between memory and the swap device. 
+ * Pages written out by the VMM are compressed into the pool (ZOUT) and 
+ * faults on them decompress them (ZIN), which takes them out of the pool.
+ * When the pool is full its LRU pages are written out to the device. 
+ * Page pi compresses to 1/ratio of a page scaled by 0.5 to 1.5 (from a 
+ * hash of pi), and is rejected and written out if that is not below a 
+ * page.
+ */
+class Zswap {
+  private:
+    int capacity, used; // in bytes
+    double ratio;
+    PageLists lru;
+    // read back from the pool, with no copy on the swap device
+    vector<bool> loaded;
+    int cnt_zin, cnt_zout, cnt_dirty, cnt_rejected, cnt_writeback;
+
+  public:
+    Zswap(double num_of_pages, double r) : lru(1) {
+      capacity = (int)(num_of_pages * PAGE_BYTES);
+      used = 0;
+      ratio = r;
+      cnt_zin = cnt_zout = cnt_dirty = cnt_rejected = cnt_writeback = 0;
+    }
+
+    int size(unsigned int pi) const {
+      unsigned int h = pi * 0x9e3779b1u;
+      h ^= h >> 16;
+      double scale = 0.5 + (h & 0xffff) / 65536.0;
+      return (int)(PAGE_BYTES * scale / ratio);
+    }
+
+    bool holds(unsigned int pi) {
+      return lru.list(pi) == 0;
+    }
+
+    bool is_loaded(unsigned int pi) const {
+      return pi < loaded.size() && loaded[pi];
+    }
+
+    // compress pi into the pool, writing the LRU pages out to make room 
+    // (added to written). False if pi does not compress well enough.
+    bool store(unsigned int pi, bool dirty, vector<unsigned int>& written) {
+      int s = size(pi);
+      if (s >= PAGE_BYTES || s > capacity) {
+        ++cnt_rejected;
+        return false;
+      }
+      while (used + s > capacity) {
+        unsigned int q = lru.lru(0);
+        lru.remove(q);
+        used -= size(q);
+        written.push_back(q);
+        ++cnt_writeback;
+      }
+      lru.push(0, pi);
+      used += s;
+      if (pi < loaded.size()) {
+        loaded[pi] = false;
+      }
+      ++cnt_zout;
+      cnt_dirty += dirty;
+      return true;
+    }
+
+    void load(unsigned int pi) {
+      lru.remove(pi);
+      used -= size(pi);
+      if (pi >= loaded.size()) {
+        loaded.resize(pi + 1, false);
+      }
+      loaded[pi] = true;
+      ++cnt_zin;
+    }
+
+    unsigned long long get_cost() const {
+      return cost_model.zswap_out * cnt_zout + 
+             cost_model.zswap_in * cnt_zin;
+    }
+
+    // every ZIN saves an IN, every ZOUT of a dirty page saves an OUT and
+    // every page written out of the pool costs one
+    void print_summary() const {
+      printf("ZSWAP %.1lf pages ratio=%.2lf ZOUT=%d ZIN=%d rejected=%d "
+             "writebacks=%d stored=%d saved I/Os=%d ===> %llu\n", 
+             (double)capacity / PAGE_BYTES, ratio, cnt_zout, cnt_zin, 
+             cnt_rejected, cnt_writeback, lru.size(0), 
+             cnt_zin + cnt_dirty - cnt_writeback, get_cost());
+    }
+};
+
+// <capacity in pages>[:<ratio>], e.g. 8:3
+Zswap* new_zswap(const char* s) {
+  double num_of_pages, ratio = 2;
+  int n = 0;
+  if (sscanf(s, "%lf%n", &num_of_pages, &n) != 1) {
+    return NULL;
+  }
+  if (s[n] == ':' && sscanf(s + n + 1, "%lf", &ratio) != 1) {
+    return NULL;
+  }
+  if (num_of_pages <= 0 || ratio <= 0) {
+    return NULL;
+  }
+  return new Zswap(num_of_pages, ratio);
+}
+
+/*
+ * NUMA: the frames are split evenly over the nodes, which sit on a ring
+ * (distance 10 to itself, 10 more per hop as in the ACPI SLIT). A frame 
+ * joins a node the first time it is used, on the node of the cpu that 
+ * faults on it (first touch) or on the next node in turn (interleave), 
+ * or on the next node with room left. With a threshold, a page referenced
+ * that many times from a remote node is moved to a free frame of that
+ * node, if it has one.
+ */
+class Numa {
+  private:
+    int num_of_nodes;
+    char policy; // f(irst touch) or i(nterleave)
+    int threshold; // remote references before a migration, 0 for none
+    int next_node; // of the interleave
+    vector<int> node_of; // node of every frame, -1 if not used yet
+    vector<int> room; // frames left per node
+    vector<int> remote_refs; // per page, since its last migration
+    long long cnt_local, cnt_remote, cnt_hops;
+    int cnt_migrations, cnt_failed;
+
+  public:
+    Numa(int n, char p, int t) {
+      num_of_nodes = n;
+      policy = p;
+      threshold = t;
+      next_node = 0;
+      cnt_local = cnt_remote = cnt_hops = 0;
+      cnt_migrations = cnt_failed = 0;
+    }
+
+    void set_num_of_frames(int num_of_frames) {
+      node_of = vector<int>(num_of_frames, -1);
+      room = vector<int>(num_of_nodes, num_of_frames / num_of_nodes);
+      for (int i = 0; i < num_of_frames % num_of_nodes; ++i) {
+        ++room[i];
+      }
+    }
+
+    int get_num_of_nodes() const {
+      return num_of_nodes;
+    }
+
+    int distance(int a, int b) const {
+      int hops = abs(a - b);
+      return 10 + 10 * min(hops, num_of_nodes - hops);
+    }
+
+    int get_node(unsigned int f) const {
+      return node_of[f];
+    }
+
+    // the node a new page of the cpu on node cpu should go to
+    int target(int cpu) {
+      if (policy == 'i') {
+        int n = next_node;
+        next_node = (next_node + 1) % num_of_nodes;
+        return n;
+      }
+      return cpu;
+    }
+
+    bool has_room(int node) const {
+      return room[node] > 0;
+    }
+
+    // put frame f, used for the first time, on node (or the next one
+    // with room)
+    void assign(unsigned int f, int node) {
+      while (room[node] == 0) {
+        node = (node + 1) % num_of_nodes;
+      }
+      node_of[f] = node;
+      --room[node];
+    }
+
+    // reference to page pi in frame f from node cpu, true if the page 
+    // should move to that node
+    bool access(unsigned int pi, unsigned int f, int cpu) {
+      int hops = (distance(cpu, node_of[f]) - 10) / 10;
+      if (hops == 0) {
+        ++cnt_local;
+        return false;
+      }
+      ++cnt_remote;
+      cnt_hops += hops;
+
+      if (threshold == 0) {
+        return false;
+      }
+      if (pi >= remote_refs.size()) {
+        remote_refs.resize(pi + 1, 0);
+      }
+      if (++remote_refs[pi] < threshold) {
+        return false;
+      }
+      remote_refs[pi] = 0;
+      return true;
+    }
+
+    void migrated(bool ok) {
+      if (ok) {
+        ++cnt_migrations;
+      } 
+      else {
+        ++cnt_failed;
+      }
+    }
+
+    unsigned long long get_cost() const {
+      return cost_model.numa_hop * cnt_hops + 
+             cost_model.numa_migrate * cnt_migrations;
+    }
+
+    void print_summary() const {
+      long long refs = cnt_local + cnt_remote;
+      printf("NUMA %d nodes %s local=%lld remote=%lld (%.2lf%%) "
+             "migrations=%d failed=%d ===> %llu\n", num_of_nodes, 
+             policy == 'i' ? "interleave" : "first-touch", cnt_local, 
+             cnt_remote, refs == 0 ? 0.0 : 100.0 * cnt_remote / refs, 
+             cnt_migrations, cnt_failed, get_cost());
+    }
+};
+
+// <nodes>[:<policy>[:<threshold>]], e.g. 2:f:4
+Numa* new_numa(const char* s) {
+  int num_of_nodes, threshold = 0, n = 0;
+  char policy = 'f';
+  if (sscanf(s, "%d%n", &num_of_nodes, &n) != 1) {
+    return NULL;
+  }
+  s += n;
+  if (*s == ':' && s[1] != '\0') {
+    policy = s[1];
+    s += 2;
+    if (*s == ':' && sscanf(s + 1, "%d", &threshold) != 1) {
+      return NULL;
+    }
+  }
+  if (num_of_nodes < 1 || threshold < 0 || strchr("fi", policy) == NULL) {
+    return NULL;
+  }
+  return new Numa(num_of_nodes, policy, threshold);
+}
+
+
+/*
+ * one line of the page table (-op, -oP) or frame table (-of, -oF) dump. 
+ * The text of every entry is kept in place in the line, and an entry is
+ * only formatted again when the value it shows has changed.
+ */
+class TableLine {
+  private:
+    // writes the text of entry i showing value v to buf, returns its length
+    typedef int (*Format)(char* buf, int i, unsigned int v);
+
+    Format format;
+    vector<unsigned int> shown; // value shown by each entry
+    vector<int> pos; // offset of each entry in text
+    string text;
+
+  public:
+    TableLine(Format f) {
+      format = f;
+    }
+
+    void update(const vector<unsigned int>& values, unsigned int mask) {
+      char buf[32];
+      if (shown.size() != values.size()) {
+        shown = vector<unsigned int>(values.size());
+        pos = vector<int>(values.size() + 1, 0);
+        text.clear();
+        for (int i = 0; i < values.size(); ++i) {
+          shown[i] = values[i] & mask;
+          pos[i] = text.size();
+          text.append(buf, format(buf, i, shown[i]));
+        }
+        pos[values.size()] = text.size();
+        text += '\n';
+        return;
+      }
+
+      for (int i = 0; i < values.size(); ++i) {
+        unsigned int v = values[i] & mask;
+        if (v == shown[i]) {
+          continue;
+        }
+        shown[i] = v;
+        int len = format(buf, i, v);
+        int old_len = pos[i + 1] - pos[i];
+        text.replace(pos[i], old_len, buf, len);
+        if (len != old_len) {
+          for (int j = i + 1; j <= values.size(); ++j) {
+            pos[j] += len - old_len;
+          }
+        }
+      }
+    }
+
+    void print() {
+      fwrite(text.data(), 1, text.size(), stdout);
+    }
+};
+
+// R, M and S of a present page, # for a paged out page, * otherwise
+int format_pte(char* buf, int i, unsigned int pte) {
+  if (get_present_bit(pte) == 1) {
+    int n = sprintf(buf, "%d:", i);
+    buf[n++] = get_referenced_bit(pte) == 1 ? 'R' : '-';
+    buf[n++] = get_modified_bit(pte) == 1 ? 'M' : '-';
+    buf[n++] = get_pagedout_bit(pte) == 1 ? 'S' : '-';
+    buf[n++] = ' ';
+    return n;
+  }
+  buf[0] = get_pagedout_bit(pte) == 1 ? '#' : '*';
+  buf[1] = ' ';
+  return 2;
+}
+
+// the page in the frame, * for a free frame
+int format_frame(char* buf, int i, unsigned int pi) {
+  if (pi == -1) {
+    buf[0] = '*';
+    buf[1] = ' ';
+    return 2;
+  }
+  return sprintf(buf, "%d ", pi);
+}
+
+// only the bits shown by format_pte
+const unsigned int PTE_FLAGS = 0xf0000000;
+
+
+/*
+ * LRU stack distances, with a fenwick tree over access times holding a 1 
+ * at the last access of every page. The times are renumbered once the 
+ * tree fills up, so it stays at twice the number of pages.
+ */
+class StackDistance {
+  private:
+    vector<int> tree;
+    vector<long long> last; // last access time of each page, -1 if none
+    long long now;
+    int marks;
+
+    void add(long long t, int v) {
+      for (int i = t + 1; i < tree.size(); i += i & -i) {
+        tree[i] += v;
+      }
+    }
+
+    // number of marks at times < t
+    int count(long long t) const {
+      int c = 0;
+      for (int i = t; i > 0; i -= i & -i) {
+        c += tree[i];
+      }
+      return c;
+    }
+
+    void compact() {
+      vector<pair<long long, int> > order;
+      for (int i = 0; i < last.size(); ++i) {
+        if (last[i] != -1) {
+          order.push_back(make_pair(last[i], i));
+        }
+      }
+      sort(order.begin(), order.end());
+
+      tree.assign(tree.size(), 0);
+      for (int t = 0; t < order.size(); ++t) {
+        last[order[t].second] = t;
+        add(t, 1);
+      }
+      now = order.size();
+    }
+
+  public:
+    StackDistance(int num_of_pages) {
+      tree = vector<int>(2 * num_of_pages + 2, 0);
+      last = vector<long long>(num_of_pages, -1);
+      now = 0;
+      marks = 0;
+    }
+
+    // record an access to page pi, returning its stack distance
+    // (1 for the top of the stack) or 0 on the first access
+    int access(unsigned int pi) {
+      if (now + 1 == tree.size()) {
+        compact();
+      }
+
+      int d = 0;
+      if (last[pi] != -1) {
+        d = marks - count(last[pi] + 1) + 1;
+        add(last[pi], -1);
+        --marks;
+      }
+      last[pi] = now;
+      add(now, 1);
+      ++marks;
+      ++now;
+      return d;
+    }
+
+    // stack distance page pi would have if it were accessed now
+    int depth(unsigned int pi) const {
+      return last[pi] == -1 ? 0 : marks - count(last[pi] + 1) + 1;
+    }
+};
+
+
+/*
+ * per page fault, IN and OUT counts, and a histogram of reuse distances:
+ * the LRU stack distance of every reference, i.e. the number of distinct
+ * pages referenced since the last reference to the same page, itself
+ * included, in buckets of powers of two. Only kept with -h, which writes
+ * it out at the end of the run.
+ */
+class PageProfile {
+  private:
+    vector<unsigned int> faults, ins, outs;
+    StackDistance stack;
+    // bucket b counts distances in [2^(b-1), 2^b), bucket 63 first uses
+    vector<unsigned long long> reuse;
+
+  public:
+    PageProfile(int num_of_pages) : stack(num_of_pages) {
+      faults = vector<unsigned int>(num_of_pages, 0);
+      ins = outs = faults;
+      reuse = vector<unsigned long long>(65, 0);
+    }
+
+    void access(unsigned int pi) {
+      int d = stack.access(pi);
+      ++reuse[d == 0 ? 63 : 32 - __builtin_clz(d)];
+    }
+
+    void fault(unsigned int pi) {
+      ++faults[pi];
+    }
+
+    void in(unsigned int pi) {
+      ++ins[pi];
+    }
+
+    void out(unsigned int pi) {
+      ++outs[pi];
+    }
+
+    // CSV rows of metric,key,value, or with a name ending in .bin the 
+    // raw arrays after a header
+    bool write(const char* name) const {
+      int n = faults.size();
+      int len = strlen(name);
+      bool binary = len >= 4 && strcmp(name + len - 4, ".bin") == 0;
+
+      FILE* file = fopen(name, binary ? "wb" : "w");
+      if (file == NULL) {
+        return false;
+      }
+      if (binary) {
+        unsigned int header[2] = {(unsigned int)n, 64};
+        fwrite("MMUPROF1", 1, 8, file);
+        fwrite(header, sizeof(header[0]), 2, file);
+        fwrite(&faults[0], sizeof(faults[0]), n, file);
+        fwrite(&ins[0], sizeof(ins[0]), n, file);
+        fwrite(&outs[0], sizeof(outs[0]), n, file);
+        fwrite(&reuse[1], sizeof(reuse[0]), 64, file);
+      } 
+      else {
+        fprintf(file, "metric,key,value\n");
+        for (int i = 0; i < n; ++i) {
+          fprintf(file, "faults,%d,%u\nins,%d,%u\nouts,%d,%u\n", 
+                  i, faults[i], i, ins[i], i, outs[i]);
+        }
+        // keyed by the smallest distance of the bucket
+        for (int b = 1; b < 63; ++b) {
+          if (reuse[b] != 0) {
+            fprintf(file, "reuse,%llu,%llu\n", 1ULL << (b - 1), reuse[b]);
+          }
+        }
+        fprintf(file, "reuse,first,%llu\n", reuse[63]);
+      }
+      return fclose(file) == 0;
+    }
+};
+
+
+/*
+ * the VMM is a template on the type of its pager. With the final pager 
+ * classes its calls to update and get_frame are direct, and the empty 
+ * update of most pagers disappears. VMM<Pager> works with any pager.
+ */
+template <class Algo>
+class VMM {
+  private:
+   
+    unsigned int frame_limit; // max no. of frames
+    
+    vector<unsigned int> frames; // frame list
+
+    vector<unsigned int> rev_frames; // frame table
+   
+    PageTable pages; // page table
+
+    TableLine page_line, frame_line; // -op/-oP and -of/-oF dumps
+
+    int cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero; // counters
+
+    Algo* algo; // page replacement algo
+
+    TLB* tlb; // optional, in front of the page table
+
+    Zswap* zswap; // optional, in front of the swap device
+
+    Numa* numa; // optional, the nodes of the frames
+    int cpu_node; // node of the current reference
+
+    // optional: the wall clock waits for the I/Os on the swap device
+    SwapDevice* device;
+    long long stall; // time spent waiting so far
+    long long pending; // completion of the I/Os of the current fault
+    vector<long long> ready; // completion of the reads ahead, per page
+
+    PageProfile* profile; // optional, with -h
+
+    // readahead: pages read in per fault, and the pages per region whose
+    // faults are checked for a stride
+    int readahead, region_size;
+    vector<int> last_fault, last_stride; // per region
+    vector<bool> prefetched; // read in by readahead, not referenced yet
+    int cnt_pin, cnt_pf_hit, cnt_pf_wasted;
+
+    // background reclaim: woken up when fewer than low_wm frames are 
+    // free, it evicts pages until high_wm frames are free
+    int low_wm, high_wm;
+    vector<unsigned int> free_frames;
+    vector<pair<unsigned int, unsigned int> > wb_batch; // (page, frame)
+    int cnt_kswapd, cnt_batches, cnt_bg_unmap, cnt_bg_out;
+
+    bool O, P, F, S, p, f, a;
+
+  public:
+    VMM(Algo* in_algo, unsigned int num_of_frames, bool iO, bool iP, 
+        bool iF, bool iS, bool ip, bool iif, bool ia) 
+      : pages(64, num_of_frames), page_line(format_pte), 
+        frame_line(format_frame) {
+
+      frame_limit = num_of_frames;
+
+      cnt_inst = cnt_unmap = cnt_map = cnt_in = cnt_out = cnt_zero = 0;
+
+      algo = in_algo;
+      tlb = NULL;
+      zswap = NULL;
+      numa = NULL;
+      cpu_node = 0;
+      device = NULL;
+      profile = NULL;
+      stall = pending = 0;
+
+      readahead = 0;
+      cnt_pin = cnt_pf_hit = cnt_pf_wasted = 0;
+
+      low_wm = high_wm = 0;
+      cnt_kswapd = cnt_batches = cnt_bg_unmap = cnt_bg_out = 0;
+      prefetched = vector<bool>(pages.size(), false);
+
+      O = iO; P = iP; F = iF; S = iS;
+      p = ip; f = iif, a = ia;
+
+      rev_frames = vector<unsigned int>(num_of_frames, -1);
+
+    }
+
+    void set_tlb(TLB* t) {
+      tlb = t;
+    }
+
+    void set_zswap(Zswap* z) {
+      zswap = z;
+    }
+
+    void set_numa(Numa* n) {
+      numa = n;
+      numa->set_num_of_frames(frame_limit);
+    }
+
+    // node of the cpu making the next reference
+    void set_cpu_node(int n) {
+      cpu_node = n;
+    }
+
+    void set_device(SwapDevice* d) {
+      device = d;
+      ready = vector<long long>(pages.size(), 0);
+    }
+
+    void set_profile(PageProfile* prof) {
+      profile = prof;
+    }
+
+    // wall clock: the cost of the work done so far, without the I/Os,
+    // plus the time spent waiting for them
+    long long now() {
+      return get_total_cost() - cost_model.in * cnt_in - 
+             cost_model.out * cnt_out - cost_model.prefetch_in * cnt_pin + 
+             stall;
+    }
+
+    long long get_stall() {
+      return stall;
+    }
+
+    // an I/O the current fault does not wait for
+    void submit_async() {
+      if (device != NULL) {
+        device->submit(now());
+      }
+    }
+
+    // an I/O the current fault waits for
+    void submit_sync() {
+      if (device != NULL) {
+        pending = max(pending, device->submit(now()));
+      }
+    }
+
+    void set_watermarks(int low, int high) {
+      low_wm = low;
+      high_wm = high;
+    }
+
+    void set_readahead(int k, int region) {
+      readahead = k;
+      region_size = region;
+      int num_of_regions = (pages.size() + region - 1) / region;
+      last_fault = vector<int>(num_of_regions, -1);
+      last_stride = vector<int>(num_of_regions, 0);
+    }
+
+
+    int num_of_free_frames() {
+      return frame_limit - frames.size() + free_frames.size();
+    }
+
+    // take a frame from the pager and unmap its page. In the background,
+    // the write back of a dirty page is added to the batch of the run.
+    unsigned int evict(bool background = false) {
+      unsigned int frame_number;
+      // the pagers that pick frames at random may pick a free one
+      do {
+        frame_number = algo->get_frame(pages, frames, rev_frames);
+      } while (rev_frames[frame_number] == -1);
+
+      // dirty pages the pager wrote back while looking for a frame
+      vector<unsigned int>& wb = algo->get_writebacks();
+      for (int i = 0; i < wb.size(); ++i) {
+        if (O) {
+          printf("%d: OUT  %4d%4d\n", cnt_inst, wb[i], 
+              get_frame_number(pages[wb[i]]));
+        }
+        submit_async();
+        if (profile != NULL) {
+          profile->out(wb[i]);
+        }
+        ++cnt_out;
+      }
+      wb.clear();
+
+      unsigned int prev_pi = rev_frames[frame_number];
+
+      if (O) {
+        printf("%d: UNMAP%4d%4d\n", cnt_inst, prev_pi, 
+            frame_number);
+      }
+      ++cnt_unmap;
+
+      if (tlb != NULL) {
+        tlb->shootdown(prev_pi);
+      }
+      if (prefetched[prev_pi]) {
+        prefetched[prev_pi] = false;
+        ++cnt_pf_wasted;
+      }
+
+      pages.clear_present(prev_pi);
+      pages.clear_referenced(prev_pi);
+
+      // a page read back from zswap has no other copy and is stored again
+      bool dirty = get_modified_bit(pages[prev_pi]) == 1;
+      if (dirty || (zswap != NULL && zswap->is_loaded(prev_pi))) {
+
+        pages.clear_modified(prev_pi);
+        pages.set_pagedout(prev_pi);
+
+        vector<unsigned int> written;
+        if (zswap != NULL && zswap->store(prev_pi, dirty, written)) {
+          if (O) {
+            printf("%d: ZOUT %4d%4d\n", cnt_inst, prev_pi, frame_number);
+            for (int i = 0; i < written.size(); ++i) {
+              printf("%d: OUT  %4d   -\n", cnt_inst, written[i]);
+            }
+          }
+          for (int i = 0; i < written.size(); ++i) {
+            submit_async();
+            if (profile != NULL) {
+              profile->out(written[i]);
+            }
+          }
+          cnt_out += written.size();
+        } 
+        else if (background) {
+          wb_batch.push_back(make_pair(prev_pi, frame_number));
+        } 
+        else {
+          if (O) {
+            printf("%d: OUT  %4d%4d\n", cnt_inst, prev_pi, 
+                frame_number);
+          }
+          submit_sync();
+          if (profile != NULL) {
+            profile->out(prev_pi);
+          }
+          ++cnt_out;
+        }
+      }
+      return frame_number;
+    }
+
+    // a frame from the free list, on the NUMA node the page should go to
+    // if there is one
+    unsigned int pop_free_frame() {
+      int i = free_frames.size() - 1;
+      if (numa != NULL) {
+        int node = numa->target(cpu_node);
+        for (int j = i; j >= 0; --j) {
+          if (numa->get_node(free_frames[j]) == node) {
+            i = j;
+            break;
+          }
+        }
+      }
+      unsigned int f = free_frames[i];
+      free_frames.erase(free_frames.begin() + i);
+      return f;
+    }
+
+    // a frame for a new page: a frame never used so far, a frame from
+    // the free list, or a frame taken from the pager
+    unsigned int get_free_frame() {
+      unsigned int f;
+      if (frames.size() < frame_limit) {
+        f = frames.size();
+        frames.push_back(f);
+        if (numa != NULL) {
+          numa->assign(f, numa->target(cpu_node));
+        }
+      } 
+      else if (!free_frames.empty()) {
+        f = pop_free_frame();
+      } 
+      else {
+        f = evict();
+      }
+      return f;
+    }
+
+    // kswapd: evict pages ahead of demand until high_wm frames are free,
+    // and write the dirty ones back in one batch
+    void reclaim() {
+      if (num_of_free_frames() >= low_wm) {
+        return;
+      }
+      ++cnt_kswapd;
+      int unmap = cnt_unmap, out = cnt_out;
+
+      while (num_of_free_frames() < high_wm) {
+        unsigned int f = evict(true);
+        rev_frames[f] = -1;
+        algo->release(frames, f);
+        free_frames.push_back(f);
+      }
+
+      if (!wb_batch.empty()) {
+        for (int i = 0; i < wb_batch.size(); ++i) {
+          if (O) {
+            printf("%d: OUT  %4d%4d\n", cnt_inst, wb_batch[i].first, 
+                wb_batch[i].second);
+          }
+          submit_async();
+          if (profile != NULL) {
+            profile->out(wb_batch[i].first);
+          }
+        }
+        cnt_out += wb_batch.size();
+        ++cnt_batches;
+        wb_batch.clear();
+      }
+
+      cnt_bg_unmap += cnt_unmap - unmap;
+      cnt_bg_out += cnt_out - out;
+    }
+
+    // a fault on pi that continues the stride of the last fault in its
+    // region reads the next pages along the stride that are swapped out
+    void prefetch(unsigned int pi) {
+      int r = pi / region_size;
+      int stride = last_fault[r] == -1 ? 0 : (int)pi - last_fault[r];
+      bool hit = stride != 0 && stride == last_stride[r];
+      last_fault[r] = pi;
+      last_stride[r] = stride;
+      if (!hit) {
+        return;
+      }
+
+      int q = pi;
+      for (int k = 0; k < readahead; ++k) {
+        q += stride;
+        if (q < 0 || q >= pages.size()) {
+          break;
+        }
+        // pages in zswap are cheaper to fault in than to read ahead
+        if (get_present_bit(pages[q]) == 1 || 
+            get_pagedout_bit(pages[q]) == 0 ||
+            (zswap != NULL && zswap->holds(q))) {
+          continue;
+        }
+
+        algo->set_reference(cnt_inst, q);
+        unsigned int frame_number = get_free_frame();
+
+        if (O) {
+          printf("%d: PIN  %4d%4d\n", cnt_inst, q, frame_number);
+          printf("%d: MAP  %4d%4d\n", cnt_inst, q, frame_number);
+        }
+        if (device != NULL) {
+          ready[q] = device->submit(now());
+        }
+        if (profile != NULL) {
+          profile->in(q);
+        }
+        ++cnt_pin;
+        ++cnt_map;
+
+        pages.set_frame(q, frame_number);
+        rev_frames[frame_number] = q;
+        pages.set_present(q);
+        prefetched[q] = true;
+        algo->update(frames, frame_number);
+      }
+    }
+
+    // NUMA balancing: move page pi to a free frame on the node of the
+    // cpu, a frame never used so far or one from the free list
+    void migrate(unsigned int pi) {
+      int g = -1;
+      if (frames.size() < frame_limit && numa->has_room(cpu_node)) {
+        g = frames.size();
+        frames.push_back(g);
+        numa->assign(g, cpu_node);
+      } 
+      else {
+        for (int i = free_frames.size() - 1; i >= 0; --i) {
+          if (numa->get_node(free_frames[i]) == cpu_node) {
+            g = free_frames[i];
+            free_frames.erase(free_frames.begin() + i);
+            break;
+          }
+        }
+      }
+      numa->migrated(g != -1);
+      if (g == -1) {
+        return;
+      }
+
+      unsigned int f = get_frame_number(pages[pi]);
+      if (O) {
+        printf("%d: MIGR %4d%4d%4d\n", cnt_inst, pi, f, g);
+      }
+      if (tlb != NULL) {
+        tlb->shootdown(pi);
+      }
+      pages.clear_present(pi);
+      pages.set_frame(pi, g);
+      pages.set_present(pi);
+      rev_frames[g] = pi;
+      rev_frames[f] = -1;
+      algo->release(frames, f);
+      free_frames.push_back(f);
+      algo->update(frames, g);
+    }
+
+    void map_page_frame(unsigned int rw, unsigned int pi) {
+      if (O) {
+        printf("==> inst: %d %d\n", rw, pi);
+      }
+
+      // the readahead goes first, so that the demand page is the most
+      // recent one for the pager and can't be evicted by it
+      if (readahead > 0 && get_present_bit(pages[pi]) == 0) {
+        prefetch(pi);
+      }
+
+      algo->set_reference(cnt_inst, pi);
+      if (profile != NULL) {
+        profile->access(pi);
+      }
+
+      if (prefetched[pi]) {
+        prefetched[pi] = false;
+        ++cnt_pf_hit;
+      }
+
+      // has not been mapped 
+      if (get_present_bit(pages[pi]) == 0) {
+        if (profile != NULL) {
+          profile->fault(pi);
+        }
+
+        unsigned int frame_number;
+        // still free frame available
+        if (frames.size() < frame_limit) {
+          frame_number = frames.size();
+          if (numa != NULL) {
+            numa->assign(frame_number, numa->target(cpu_node));
+          }
+
+          pages.set_frame(pi, frame_number);
+
+          if (O) {
+            printf("%d: ZERO     %4d\n", cnt_inst, frame_number);
+            printf("%d: MAP  %4d%4d\n", cnt_inst, pi, frame_number);
+          }
+
+          ++cnt_zero;
+          ++cnt_map;
+
+          frames.push_back(frame_number);
+
+          rev_frames[frame_number] = pi;
+
+          
+        } // have to replace a frame
+        else {
+          if (!free_frames.empty()) {
+            frame_number = pop_free_frame();
+          } 
+          else {
+            frame_number = evict();
+          }
+
+          if (zswap != NULL && zswap->holds(pi)) {
+
+            if (O) {
+              printf("%d: ZIN  %4d%4d\n", cnt_inst, pi, frame_number);
+            }
+            zswap->load(pi);
+          } 
+          else if (get_pagedout_bit(pages[pi]) == 1) {
+
+            if (O) {
+              printf("%d: IN   %4d%4d\n", cnt_inst, pi, frame_number);
+            }
+            submit_sync();
+            if (profile != NULL) {
+              profile->in(pi);
+            }
+            ++cnt_in;
+          } 
+          else {
+
+            if (O) {
+              printf("%d: ZERO     %4d\n", cnt_inst, frame_number);
+            }
+            ++cnt_zero;
+          }
+
+          if (O) {
+            printf("%d: MAP  %4d%4d\n", cnt_inst, pi, frame_number);
+          }
+          ++cnt_map;
+
+          pages.set_frame(pi, frame_number);
+          rev_frames[frame_number] = pi;
+        }
+
+        // set respective bit
+        pages.set_present(pi);
+        if (rw == 0) {
+          pages.set_referenced(pi);
+        } 
+        else {
+          pages.set_referenced(pi);
+          pages.set_modified(pi);
+        }
+
+      } // if the corresponding entry is already in the frame table
+      else {
+        if (rw == 0) {
+          pages.set_referenced(pi);
+        } 
+        else {
+          pages.set_referenced(pi);
+          pages.set_modified(pi);
+        }
+      }
+      if (device != NULL) {
+        // the fault and the read ahead of pi, if still in flight
+        long long t = now();
+        stall += max(max(pending, ready[pi]), t) - t;
+        pending = ready[pi] = 0;
+      }
+      if (tlb != NULL) {
+        tlb->translate(pi);
+      }
+      algo->update(frames, get_frame_number(pages[pi]));
+      if (numa != NULL && 
+          numa->access(pi, get_frame_number(pages[pi]), cpu_node)) {
+        migrate(pi);
+      }
+      if (low_wm > 0) {
+        reclaim();
+      }
+      ++cnt_inst;
+
+      // print virtual pages each cycle
+      if (p) {
+        print_pages();
+      }
+
+      // print phyical frames each cycle
+      if (f) {
+        print_frames();
+      }
+    } // end map_page_frame
+
+
+    // demand faults, without the pages read ahead
+    long long get_num_of_faults() const {
+      return cnt_map - cnt_pin;
+    }
+
+    void print_pages() {
+      page_line.update(pages.entries(), PTE_FLAGS);
+      page_line.print();
+    }
+
+    void print_frames() {
+      frame_line.update(rev_frames, 0xffffffff);
+      frame_line.print();
+    }
+
+    void print_summary() {
+      if (P) {
+        print_pages();
+      }
+      if (F) {
+        print_frames();
+      }
+      if (S) {
+        printf("%s\n", get_summary().c_str());
+        if (tlb != NULL) {
+          tlb->print_summary();
+        }
+        if (zswap != NULL) {
+          zswap->print_summary();
+        }
+        if (numa != NULL) {
+          numa->print_summary();
+        }
+        if (device != NULL) {
+          long long wall = now();
+          printf("SWAP depth=%lld I/Os=%lld avg latency=%.1lf wall=%lld "
+                 "stall=%lld (%.2lf%%)\n", cost_model.swap_depth, 
+                 device->get_num_of_ios(), device->get_avg_latency(), 
+                 wall, stall, wall == 0 ? 0.0 : 100.0 * stall / wall);
+        }
+        if (low_wm > 0) {
+          unsigned long long bg = get_cost(0, cnt_bg_unmap, 0, 0, 
+                                           cnt_bg_out, 0);
+          printf("KSWAPD %d:%d runs=%d U=%d O=%d batches=%d "
+                 "foreground ===> %llu background ===> %llu\n", 
+                 low_wm, high_wm, cnt_kswapd, cnt_bg_unmap, cnt_bg_out, 
+                 cnt_batches, get_total_cost() - bg, bg);
+        }
+        if (readahead > 0) {
+          printf("PREFETCH K=%d PIN=%d hits=%d wasted=%d (%.2lf%%) "
+                 "===> %llu\n", readahead, cnt_pin, cnt_pf_hit, 
+                 cnt_pf_wasted, 
+                 cnt_pin == 0 ? 0.0 : 100.0 * cnt_pf_hit / cnt_pin, 
+                 cost_model.prefetch_in * cnt_pin);
+        }
+      }
+    }
+
+    unsigned long long get_total_cost() {
+      unsigned long long cost;
+
+      cost = get_cost(cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, 
+                      cnt_zero);
+      if (tlb != NULL) {
+        cost += tlb->get_cost();
+      }
+      cost += cost_model.prefetch_in * cnt_pin;
+      if (zswap != NULL) {
+        cost += zswap->get_cost();
+      }
+      if (numa != NULL) {
+        cost += numa->get_cost();
+      }
+      return cost;
+    }
+
+    // the SUM line of the summary, with the counters multiplied by scale
+    // for a run over a sampled trace
+    string get_summary(double scale = 1) {
+      char buf[200];
+
+      snprintf(buf, sizeof(buf), 
+               "SUM %lld U=%lld M=%lld I=%lld O=%lld Z=%lld ===> %llu",
+               llround(cnt_inst * scale), llround(cnt_unmap * scale), 
+               llround(cnt_map * scale), llround(cnt_in * scale),
+               llround(cnt_out * scale), llround(cnt_zero * scale), 
+               (unsigned long long)llround(get_total_cost() * scale));
+      return buf;
+    }
+};
+
+void read_random_file(string s, vector<int>& rand_nums, int& count_random) {
+  ifstream fin;
+  fin.open(s.c_str());
+  string line;
+
+  if (fin.is_open()) {
+    getline(fin,line);
+    count_random = atoi(line.c_str());
+    while (getline(fin, line)) {
+      rand_nums.push_back(atoi(line.c_str()));
+    }
+  }
+  else {
+    fprintf(stderr, "Unable to open random file\n");
+  }
+  fin.close();
+}
+
+
+/*
+ * input file mapped into memory, read in whole if it can't be mapped
+ */
+class MappedFile {
+  private:
+    const char* data;
+    size_t len;
+    bool mapped;
+    vector<char> copy;
+
+  public:
+    MappedFile() {
+      data = NULL;
+      len = 0;
+      mapped = false;
+    }
+
+    ~MappedFile() {
+      if (mapped) {
+        munmap((void*)data, len);
+      }
+    }
+
+    bool open(const char* name) {
+      int fd = ::open(name, O_RDONLY);
+      if (fd == -1) {
+        return false;
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+          madvise(m, st.st_size, MADV_SEQUENTIAL);
+          data = (const char*)m;
+          len = st.st_size;
+          mapped = true;
+          ::close(fd);
+          return true;
+        }
+      }
+
+      char buf[1 << 16];
+      ssize_t n;
+      while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        copy.insert(copy.end(), buf, buf + n);
+      }
+      ::close(fd);
+      data = copy.empty() ? NULL : &copy[0];
+      len = copy.size();
+      return true;
+    }
+
+    const char* begin() const {
+      return data;
+    }
+
+    const char* end() const {
+      return data + len;
+    }
+
+    size_t size() const {
+      return len;
+    }
+};
+
+
+class TraceReader {
+  public:
+    virtual ~TraceReader() {
+    }
+
+    // next reference in the trace, false at the end of the trace
+    virtual bool next(unsigned int& rw, unsigned int& pi) = 0;
+
+    // NUMA node of the cpu making the last reference, unsigned so that
+    // any value taken modulo the number of nodes is a node
+    virtual unsigned int get_node() const {
+      return 0;
+    }
+};
+
+class FileTraceReader : public TraceReader {
+  protected:
+    MappedFile file;
+    const char* pos;
+    const char* end;
+
+  public:
+    bool open(const char* name, size_t skip) {
+      if (!file.open(name)) {
+        return false;
+      }
+      pos = file.begin() + skip;
+      end = file.end();
+      return true;
+    }
+};
+
+class Reader_Text : public FileTraceReader {
+  private:
+    unsigned int node; // optional third column
+    // hand rolled replacement for sscanf("%d"), false if no number
+    bool scan_int(unsigned int& v) {
+      while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+        ++pos;
+      }
+      bool neg = false;
+      if (pos < end && (*pos == '-' || *pos == '+')) {
+        neg = (*pos == '-');
+        ++pos;
+      }
+      if (pos == end || (unsigned)(*pos - '0') > 9) {
+        return false;
+      }
+      unsigned int n = 0;
+      while (pos < end && (unsigned)(*pos - '0') <= 9) {
+        n = n * 10 + (*pos - '0');
+        ++pos;
+      }
+      v = neg ? -n : n;
+      return true;
+    }
+
+    void skip_line() {
+      const char* nl = (const char*)memchr(pos, '\n', end - pos);
+      pos = (nl == NULL) ? end : nl + 1;
+    }
+
+  public:
+    bool next(unsigned int& rw, unsigned int& pi) {
+      while (pos < end) {
+        // comment line
+        if (*pos == '#') {
+          skip_line();
+          continue;
+        }
+        bool ok = scan_int(rw) && scan_int(pi);
+        if (ok && !scan_int(node)) {
+          node = 0;
+        }
+        skip_line();
+        if (ok) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    unsigned int get_node() const {
+      return node;
+    }
+};
+
+class Reader_Binary : public FileTraceReader {
+  private:
+    unsigned int prev;
+
+  public:
+    Reader_Binary() {
+      prev = 0;
+    }
+
+    bool next(unsigned int& rw, unsigned int& pi) {
+      if (pos >= end) {
+        return false;
+      }
+
+      unsigned int v = 0;
+      int shift = 0;
+      unsigned char b;
+      do {
+        if (pos == end) {
+          fprintf(stderr, "Truncated binary trace\n");
+          return false;
+        }
+        b = *pos++;
+        // a 32 bit value takes at most 5 bytes, the last with 4 bits
+        if (shift == 28 && (b & 0xf0) != 0) {
+          fprintf(stderr, "Corrupt binary trace\n");
+          return false;
+        }
+        v |= (unsigned int)(b & 0x7f) << shift;
+        shift += 7;
+      } while (b & 0x80);
+
+      rw = v & 1;
+      prev += zigzag_decode(v >> 1);
+      pi = prev;
+      return true;
+    }
+};
+
+// replays a trace loaded with load_trace
+class Reader_Memory : public TraceReader {
+  private:
+    const vector<unsigned int>& refs;
+    size_t pos;
+
+  public:
+    Reader_Memory(const vector<unsigned int>& r) : refs(r) {
+      pos = 0;
+    }
+
+    bool next(unsigned int& rw, unsigned int& pi) {
+      if (pos == refs.size()) {
+        return false;
+      }
+      rw = get_ref_rw(refs[pos]);
+      pi = get_ref_page(refs[pos]);
+      ++pos;
+      return true;
+    }
+};
+
+// true if the trace is in the binary format
+bool is_binary_trace(const MappedFile& file) {
+  return file.size() >= sizeof(trace_magic) &&
+         memcmp(file.begin(), trace_magic, sizeof(trace_magic)) == 0;
+}
+
+// open a text or binary trace, telling them apart by the header
+TraceReader* open_trace(const char* name) {
+  MappedFile probe;
+  if (!probe.open(name)) {
+    return NULL;
+  }
+
+  FileTraceReader* r;
+  size_t skip = 0;
+  if (is_binary_trace(probe)) {
+    r = new Reader_Binary();
+    skip = sizeof(trace_magic);
+  } 
+  else {
+    r = new Reader_Text();
+  }
+
+  if (!r->open(name, skip)) {
+    delete r;
+    return NULL;
+  }
+  return r;
+}
+
+// next valid instruction of the trace, skipping out of range pages
+bool get_next_instruction(unsigned int& rw, unsigned int& pi, 
+                          TraceReader* trace) {
+  while (trace->next(rw, pi)) {
+    if (pi > 63) {
+      fprintf(stderr, "Virtual page index is out of range\n");
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+/*
+ * SHARDS sampling: a page is sampled iff the hash of its number is below 
+ * rate * 2^24. All references to a sampled page are kept, so the stack 
+ * distances among the sampled pages are the distances in the whole trace 
+ * scaled by the share of the pages that are sampled. With few pages that
+ * share can be far from the rate, so it is counted as the pages show up.
+ */
+class Sampler {
+  private:
+    double rate;
+    unsigned int threshold;
+    vector<bool> seen;
+    int cnt_pages, cnt_sampled;
+
+  public:
+    Sampler(double r = 1.0) {
+      rate = r;
+      threshold = (unsigned int)(r * (1 << 24));
+      cnt_pages = cnt_sampled = 0;
+    }
+
+    double get_rate() const {
+      return rate;
+    }
+
+    // share of the pages seen so far that are sampled
+    double get_page_rate() const {
+      return cnt_pages == 0 ? rate : (double)cnt_sampled / cnt_pages;
+    }
+
+    // whether pi is sampled, without counting it
+    bool sampled(unsigned int pi) const {
+      if (rate >= 1) {
+        return true;
+      }
+      unsigned int h = pi * 0x9e3779b1u;
+      h ^= h >> 16;
+      h *= 0x85ebca6bu;
+      h ^= h >> 13;
+      return (h & 0xffffff) < threshold;
+    }
+
+    bool keep(unsigned int pi) {
+      if (rate >= 1) {
+        return true;
+      }
+      bool k = sampled(pi);
+
+      if (pi >= seen.size()) {
+        seen.resize(pi + 1, false);
+      }
+      if (!seen[pi]) {
+        seen[pi] = true;
+        ++cnt_pages;
+        cnt_sampled += k;
+      }
+      return k;
+    }
+
+    // a stack distance among the sampled pages, as a distance in the 
+    // whole trace: each of the other d - 1 pages stands for several
+    int scale(int d) const {
+      if (rate >= 1 || d == 0) {
+        return d;
+      }
+      return 1 + (int)lround((d - 1) / get_page_rate());
+    }
+};
+
+// read the trace into refs, only the sampled pages if there is a sampler.
+// Returns the number of references in the whole trace.
+long long load_trace(TraceReader* trace, vector<unsigned int>& refs, 
+                     Sampler* sampler = NULL) {
+  unsigned int rw, pi;
+  long long n = 0;
+  while (get_next_instruction(rw, pi, trace)) {
+    if (sampler == NULL || sampler->keep(pi)) {
+      refs.push_back(make_ref(rw, pi));
+    }
+    ++n;
+  }
+  return n;
+}
+
+// convert a trace (text or binary) into the binary format
+int convert_trace(const char* in_name, const char* out_name) {
+  TraceReader* in = open_trace(in_name);
+  if (in == NULL) {
+    fprintf(stderr, "Unable to open input file\n");
+    return 1;
+  }
+
+  FILE* out = fopen(out_name, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "Unable to open output file\n");
+    delete in;
+    return 1;
+  }
+
+  vector<unsigned char> buf;
+  buf.insert(buf.end(), trace_magic, trace_magic + sizeof(trace_magic));
+
+  unsigned int rw, pi, prev = 0;
+  while (in->next(rw, pi)) {
+    put_reference(buf, prev, rw, pi);
+    if (buf.size() >= (1 << 20)) {
+      fwrite(&buf[0], 1, buf.size(), out);
+      buf.clear();
+    }
+  }
+  fwrite(&buf[0], 1, buf.size(), out);
+
+  fclose(out);
+  delete in;
+  return 0;
+}
+
+
+/*
+ * LRU fault counts for every number of frames from one pass over the
+ * trace. With n frames a reference faults iff its stack distance is 
+ * greater than n, and a page is evicted between two references iff the 
+ * distance of the second one is greater than n. It is written out on that
+ * eviction iff it was written since the last fault, i.e. n is at least the
+ * largest distance since its last write. Bit n - 1 of swapped[p] says 
+ * whether p has been written out already with n frames, which tells IN
+ * from ZERO. With a sampling rate below 1 only the references to the 
+ * sampled pages are simulated, and the counts are estimates.
+ */
+class MissRatioCurve {
+  private:
+    int max_frames;
+    StackDistance stack;
+    Sampler sampler;
+    long long cnt_inst, cnt_sampled;
+
+    // difference arrays over the number of frames
+    vector<long long> faults, outs;
+    vector<long long> ins;
+
+    vector<bool> written; // written since its first access
+    vector<int> dist_max; // largest distance since the last write
+    vector<unsigned long long> swapped;
+
+    // bits lo - 1 .. hi - 1
+    unsigned long long range_mask(int lo, int hi) {
+      return (~0ULL >> (63 - (hi - 1))) & (~0ULL << (lo - 1));
+    }
+
+    void add_range(vector<long long>& diff, int lo, int hi) {
+      diff[lo] += 1;
+      diff[hi + 1] -= 1;
+    }
+
+    // page pi is evicted with n frames for every n < d
+    void evict(unsigned int pi, int d) {
+      if (!written[pi]) {
+        return;
+      }
+      int lo = max(dist_max[pi], 1);
+      int hi = min(d - 1, max_frames);
+      if (lo <= hi) {
+        add_range(outs, lo, hi);
+        swapped[pi] |= range_mask(lo, hi);
+      }
+    }
+
+  public:
+    MissRatioCurve(int num_of_pages, int num_of_frames, double rate = 1) 
+      : stack(num_of_pages), sampler(rate) {
+      max_frames = num_of_frames;
+      cnt_inst = cnt_sampled = 0;
+      faults = vector<long long>(max_frames + 2, 0);
+      outs = faults;
+      ins = faults;
+      written = vector<bool>(num_of_pages, false);
+      dist_max = vector<int>(num_of_pages, 0);
+      swapped = vector<unsigned long long>(num_of_pages, 0);
+    }
+
+    void access(unsigned int rw, unsigned int pi) {
+      ++cnt_inst;
+      if (!sampler.keep(pi)) {
+        return;
+      }
+      ++cnt_sampled;
+
+      int d = sampler.scale(stack.access(pi));
+      if (d != 0) {
+        evict(pi, d);
+      }
+
+      // faults for every n < d
+      int hi = (d == 0) ? max_frames : min(d - 1, max_frames);
+      if (hi >= 1) {
+        add_range(faults, 1, hi);
+        for (unsigned long long m = swapped[pi] & range_mask(1, hi); m != 0;
+             m &= m - 1) {
+          ++ins[__builtin_ctzll(m) + 1];
+        }
+      }
+
+      if (rw == 1) {
+        written[pi] = true;
+        dist_max[pi] = 0;
+      }
+      else if (d == 0 || d > dist_max[pi]) {
+        dist_max[pi] = (d == 0) ? max_frames + 1 : d;
+      }
+    }
+
+    void print_summary() {
+      // pages evicted after their last reference
+      for (int i = 0; i < written.size(); ++i) {
+        if (written[i] && stack.depth(i) > 0) {
+          evict(i, sampler.scale(stack.depth(i)));
+        }
+      }
+
+      // sampled counts scale up by the share of the references sampled
+      double s = cnt_sampled == 0 ? 0 : (double)cnt_inst / cnt_sampled;
+      long long m = 0, o = 0;
+      for (int n = 1; n <= max_frames; ++n) {
+        m += faults[n];
+        o += outs[n];
+        long long em = llround(m * s), eo = llround(o * s);
+        long long ei = llround(ins[n] * s);
+        long long u = max(em - n, 0LL);
+        long long z = em - ei;
+        printf("%d: SUM %lld U=%lld M=%lld I=%lld O=%lld Z=%lld ===> %llu\n",
+               n, cnt_inst, u, em, ei, eo, z,
+               get_cost(cnt_inst, u, em, ei, eo, z));
+      }
+    }
+};
+
+/*
+ * runs every (algo, number of frames) pair over one trace on a pool of 
+ * threads. Text traces are parsed once into memory, binary traces are 
+ * decoded by every run from the shared mapping (except for OPT, which
+ * needs them in memory). Every run has its own
+ * VMM and pager, and reads the random numbers from the start, so each 
+ * row is the SUM line of the matching standalone run.
+ */
+class Sweep {
+  private:
+    const char* trace_name;
+    bool binary;
+    bool in_memory; // refs holds the trace
+    vector<unsigned int> refs;
+
+    // with a rate below 1 every run simulates the sampled pages on the 
+    // same share of the frames, and scales its counts back up
+    Sampler sampler;
+    double scale;
+
+    vector<int> rand_nums;
+    int count_random;
+
+    vector<pair<char, int> > configs;
+    vector<string> results;
+    atomic<int> next_config;
+
+    const char* tlb_spec; // every run gets its own TLB, if any
+    const char* zswap_spec; // and zswap pool
+    int readahead, region_size;
+    int low_wm, high_wm;
+
+    // the run of configs[i] with its pager
+    class Run {
+      public:
+        Sweep* sweep;
+        int i;
+
+        template <class Algo>
+        void operator()(Algo* algo) {
+          sweep->run_config(i, algo);
+        }
+    };
+
+    template <class Algo>
+    void run_config(int i, Algo* algo) {
+      int num_of_frames = configs[i].second;
+      if (sampler.get_rate() < 1) {
+        num_of_frames = max((int)lround(num_of_frames * 
+                                        sampler.get_page_rate()), 1);
+      }
+      algo->set_random(rand_nums, count_random);
+      algo->set_num_of_frames(num_of_frames);
+
+      VMM<Algo> v(algo, num_of_frames, false, false, false, true, 
+                  false, false, false);
+
+      TLB* tlb = tlb_spec != NULL ? new_tlb(tlb_spec) : NULL;
+      v.set_tlb(tlb);
+      Zswap* zswap = zswap_spec != NULL ? new_zswap(zswap_spec) : NULL;
+      v.set_zswap(zswap);
+      if (readahead > 0) {
+        v.set_readahead(readahead, region_size);
+      }
+      v.set_watermarks(low_wm, high_wm);
+      // the cost model is shared, the swap device is the run's own
+      SwapDevice* device = NULL;
+      if (cost_model.swap_depth > 0) {
+        device = new SwapDevice();
+        v.set_device(device);
+      }
+
+      set_trace(algo, refs);
+
+      TraceReader* trace;
+      if (!in_memory) {
+        trace = open_trace(trace_name);
+      } 
+      else {
+        trace = new Reader_Memory(refs);
+      }
+
+      unsigned int rw, pi;
+      while (get_next_instruction(rw, pi, trace)) {
+        if (in_memory || sampler.sampled(pi)) {
+          v.map_page_frame(rw, pi);
+        }
+      }
+      results[i] = v.get_summary(scale);
+      if (device != NULL) {
+        char buf[100];
+        snprintf(buf, sizeof(buf), " wall=%lld stall=%lld", 
+                 llround(v.now() * scale), llround(v.get_stall() * scale));
+        results[i] += buf;
+      }
+
+      delete device;
+      delete trace;
+      delete tlb;
+      delete zswap;
+      delete algo;
+    }
+
+    void run_config(int i) {
+      Run run;
+      run.sweep = this;
+      run.i = i;
+      with_pager(configs[i].first, "", run);
+    }
+
+    void worker() {
+      int i;
+      while ((i = next_config++) < configs.size()) {
+        run_config(i);
+      }
+    }
+
+  public:
+    Sweep(const char* name, vector<int>& r, int c) {
+      trace_name = name;
+      rand_nums = r;
+      count_random = c;
+      tlb_spec = NULL;
+      zswap_spec = NULL;
+      readahead = 0;
+      low_wm = high_wm = 0;
+      scale = 1;
+    }
+
+    void set_sampling(double rate) {
+      sampler = Sampler(rate);
+    }
+
+    void set_tlb(const char* spec) {
+      tlb_spec = spec;
+    }
+
+    void set_zswap(const char* spec) {
+      zswap_spec = spec;
+    }
+
+    void set_readahead(int k, int region) {
+      readahead = k;
+      region_size = region;
+    }
+
+    void set_watermarks(int low, int high) {
+      low_wm = low;
+      high_wm = high;
+    }
+
+    bool load() {
+      MappedFile probe;
+      if (!probe.open(trace_name)) {
+        return false;
+      }
+      binary = is_binary_trace(probe);
+
+      // a binary trace is streamed by every run, through the sampler if
+      // any; this pass only counts the sampled pages and references
+      in_memory = false;
+      long long n = 0, kept = 0;
+      TraceReader* trace = open_trace(trace_name);
+      if (!binary) {
+        n = load_trace(trace, refs, &sampler);
+        kept = refs.size();
+        in_memory = true;
+      }
+      else if (sampler.get_rate() < 1) {
+        unsigned int rw, pi;
+        while (get_next_instruction(rw, pi, trace)) {
+          kept += sampler.keep(pi);
+          ++n;
+        }
+      }
+      delete trace;
+      if (sampler.get_rate() < 1) {
+        scale = kept == 0 ? 0 : (double)n / kept;
+      }
+      return true;
+    }
+
+    void add(char algo, int num_of_frames) {
+      configs.push_back(make_pair(algo, num_of_frames));
+    }
+
+    void run(int num_of_threads) {
+      // OPT needs the whole trace up front
+      for (int i = 0; i < configs.size(); ++i) {
+        if (!in_memory && configs[i].first == 'O') {
+          TraceReader* trace = open_trace(trace_name);
+          load_trace(trace, refs, &sampler);
+          delete trace;
+          in_memory = true;
+        }
+      }
+
+      results = vector<string>(configs.size());
+      next_config = 0;
+
+      vector<thread> pool;
+      for (int i = 0; i < num_of_threads; ++i) {
+        pool.push_back(thread(&Sweep::worker, this));
+      }
+      for (int i = 0; i < pool.size(); ++i) {
+        pool[i].join();
+      }
+
+      for (int i = 0; i < configs.size(); ++i) {
+        printf("%c %d: %s\n", configs[i].first, configs[i].second, 
+               results[i].c_str());
+      }
+    }
+};
+
+// parse a list of frame counts like "4,8,16-32"
+bool parse_frame_list(const char* s, vector<int>& list) {
+  while (*s != '\0') {
+    int lo, hi, n;
+    if (sscanf(s, "%d-%d%n", &lo, &hi, &n) == 2) {
+      s += n;
+    } 
+    else if (sscanf(s, "%d%n", &lo, &n) == 1) {
+      hi = lo;
+      s += n;
+    } 
+    else {
+      return false;
+    }
+    for (int i = lo; i <= hi; ++i) {
+      list.push_back(i);
+    }
+    if (*s == ',') {
+      ++s;
+    }
+  }
+  return true;
+}
+
+/*
+ * atomic pte updates for the page table shared by the threads of -c
+ */
+
+// apply fn to a copy of the pte and store it with compare and swap,
+// again until no other thread has changed the pte in between. Returns 
+// the old value.
+template <class F>
+unsigned int update_pte(atomic<unsigned int>& p, F fn) {
+  unsigned int old = p.load();
+  unsigned int pte;
+  do {
+    pte = old;
+    fn(pte);
+  } while (!p.compare_exchange_weak(old, pte));
+  return old;
+}
+
+const unsigned int PTE_PRESENT = 0x80000000;
+const unsigned int PTE_MODIFIED = 0x40000000;
+const unsigned int PTE_REFERENCED = 0x20000000;
+
+
+/*
+ * one page table and frame pool shared by several threads, each replaying
+ * its own trace. A hit sets R (and M) with compare and swap, so it fails
+ * and faults instead if the page is unmapped meanwhile. A fault locks its
+ * page only. It takes a frame never used so far, or else the clock hand
+ * (an atomic counter) looks for a victim: a present page whose lock it 
+ * gets with try_lock, and whose R bit, cleared on the way, is still clear
+ * when its pte is swapped to not present.
+ */
+class SharedVMM {
+  public:
+    class Counters {
+      public:
+        long long inst, unmap, map, in, out, zero;
+
+        Counters() {
+          inst = unmap = map = in = out = zero = 0;
+        }
+
+        void add(const Counters& c) {
+          inst += c.inst; unmap += c.unmap; map += c.map;
+          in += c.in; out += c.out; zero += c.zero;
+        }
+    };
+
+  private:
+    int num_of_frames;
+    vector<atomic<unsigned int> > ptes;
+    vector<mutex> locks; // one per page
+    vector<atomic<int> > rev_frames; // page in each frame, or -1
+    atomic<int> next_frame; // first frame never used so far
+    atomic<unsigned int> hand;
+
+    // a frame for page pi, whose lock is held
+    int get_frame(Counters& c) {
+      if (next_frame.load() < num_of_frames) {
+        int f = next_frame++;
+        if (f < num_of_frames) {
+          return f;
+        }
+      }
+
+      while (true) {
+        int f = hand++ % num_of_frames;
+        int q = rev_frames[f].load();
+        // being filled by another fault
+        if (q == -1 || !locks[q].try_lock()) {
+          continue;
+        }
+        unsigned int old = ptes[q].load();
+        if (rev_frames[f].load() != q || get_present_bit(old) == 0) {
+          locks[q].unlock();
+          continue;
+        }
+        if (get_referenced_bit(old) == 1) {
+          ptes[q].fetch_and(~PTE_REFERENCED);
+          locks[q].unlock();
+          continue;
+        }
+
+        unsigned int pte = old;
+        clear_present_bit(pte);
+        if (get_modified_bit(pte) == 1) {
+          clear_modified_bit(pte);
+          set_pagedout_bit(pte);
+        }
+        // a hit got in between and set R: second chance after all
+        if (!ptes[q].compare_exchange_strong(old, pte)) {
+          locks[q].unlock();
+          continue;
+        }
+
+        rev_frames[f].store(-1);
+        locks[q].unlock();
+        ++c.unmap;
+        if (get_modified_bit(old) == 1) {
+          ++c.out;
+        }
+        return f;
+      }
+    }
+
+  public:
+    SharedVMM(int num_of_pages, int frames) 
+      : ptes(num_of_pages), locks(num_of_pages), rev_frames(frames) {
+      num_of_frames = frames;
+      for (int i = 0; i < num_of_pages; ++i) {
+        ptes[i].store(0);
+      }
+      for (int i = 0; i < frames; ++i) {
+        rev_frames[i].store(-1);
+      }
+      next_frame = 0;
+      hand = 0;
+    }
+
+    void map_page_frame(unsigned int rw, unsigned int pi, Counters& c) {
+      ++c.inst;
+      unsigned int bits = PTE_REFERENCED | (rw == 1 ? PTE_MODIFIED : 0);
+
+      while (true) {
+        unsigned int old = ptes[pi].load();
+        while (get_present_bit(old) == 1) {
+          if (ptes[pi].compare_exchange_weak(old, old | bits)) {
+            return;
+          }
+        }
+
+        lock_guard<mutex> guard(locks[pi]);
+        // mapped by another thread in the meantime
+        if (get_present_bit(ptes[pi].load()) == 1) {
+          continue;
+        }
+
+        int f = get_frame(c);
+        unsigned int prev = update_pte(ptes[pi], [&](unsigned int& p) {
+          set_frame_number(p, f);
+          p |= PTE_PRESENT | bits;
+        });
+        if (get_pagedout_bit(prev) == 1) {
+          ++c.in;
+        } 
+        else {
+          ++c.zero;
+        }
+        ++c.map;
+        rev_frames[f].store(pi);
+        return;
+      }
+    }
+};
+
+/*
+ * runs the traces on 1, 2, ... threads sharing one SharedVMM each time,
+ * thread i replaying trace i modulo the number of traces
+ */
+void run_shared(vector<vector<unsigned int> >& traces, int num_of_frames,
+                const vector<int>& thread_counts) {
+  for (int k = 0; k < thread_counts.size(); ++k) {
+    int n = thread_counts[k];
+    SharedVMM v(64, num_of_frames);
+    vector<SharedVMM::Counters> counters(n);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int i = 0; i < n; ++i) {
+      pool.push_back(thread([&, i]() {
+        vector<unsigned int>& refs = traces[i % traces.size()];
+        for (size_t j = 0; j < refs.size(); ++j) {
+          v.map_page_frame(get_ref_rw(refs[j]), get_ref_page(refs[j]),
+                           counters[i]);
+        }
+      }));
+    }
+    for (int i = 0; i < n; ++i) {
+      pool[i].join();
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - 
+                                           start).count();
+
+    SharedVMM::Counters c;
+    for (int i = 0; i < n; ++i) {
+      c.add(counters[i]);
+    }
+    printf("%d threads: SUM %lld U=%lld M=%lld I=%lld O=%lld Z=%lld "
+           "===> %llu %.3lfs %.0lf faults/sec\n", n, c.inst, c.unmap, 
+           c.map, c.in, c.out, c.zero, 
+           get_cost(c.inst, c.unmap, c.map, c.in, c.out, c.zero), secs,
+           c.map / secs);
+  }
+}
+
+
+/*
+ * fork and shared mappings (-F). Every process has a page table of its 
+ * own, and each of its ptes maps a page object: a private page, a page 
+ * shared copy on write since a fork, or a page of a shared mapping. An 
+ * object is in at most one frame, which all its ptes map, so the number 
+ * of its mappings is the reference count of the frame. A write to a page 
+ * shared copy on write (COW bit) copies it into a frame of its own, unless
+ * no other pte maps it any more. Frames are replaced by the physical 
+ * clock, a frame being referenced if any of the ptes mapping it is.
+ */
+class ForkVMM {
+  private:
+    class Object {
+      public:
+        int frame; // -1 if not in memory
+        int present; // ptes mapping it present
+        bool pagedout, dirty, shared;
+        vector<pair<int, int> > mappings; // (process, page)
+    };
+
+    vector<vector<unsigned int> > tables; // page table of every process
+    vector<vector<int> > object_of; // object of every pte, or -1
+    vector<Object> objects;
+    vector<int> free_objects;
+
+    int frame_limit;
+    int next_frame; // first frame never used so far
+    vector<int> free_frames;
+    vector<int> object_in; // object in every frame, or -1
+    int hand;
+    int pinned; // frame being copied, not to be replaced
+
+    int pid; // current process
+
+    long long cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero;
+    long long cnt_cow, cnt_fork, cnt_exit;
+    int cnt_saved; // frames a private copy of every present pte would add
+    long long sum_saved;
+    int max_saved;
+
+    void ensure_process(int p) {
+      if (p >= tables.size()) {
+        tables.resize(p + 1, vector<unsigned int>(64, 0));
+        object_of.resize(p + 1, vector<int>(64, -1));
+      }
+    }
+
+    void pte_mapped(int o) {
+      if (objects[o].present++ > 0) {
+        ++cnt_saved;
+      }
+    }
+
+    void pte_unmapped(int o) {
+      if (--objects[o].present > 0) {
+        --cnt_saved;
+      }
+    }
+
+    int new_object(bool shared) {
+      int o;
+      if (!free_objects.empty()) {
+        o = free_objects.back();
+        free_objects.pop_back();
+      } 
+      else {
+        o = objects.size();
+        objects.push_back(Object());
+      }
+      objects[o].frame = -1;
+      objects[o].present = 0;
+      objects[o].pagedout = objects[o].dirty = false;
+      objects[o].shared = shared;
+      objects[o].mappings.clear();
+      return o;
+    }
+
+    void attach(int o, int p, int pi) {
+      objects[o].mappings.push_back(make_pair(p, pi));
+      object_of[p][pi] = o;
+    }
+
+    // drop the mapping of page pi of process p, and the object with it if
+    // that was the last one
+    void detach(int p, int pi) {
+      int o = object_of[p][pi];
+      Object& ob = objects[o];
+      ob.mappings.erase(find(ob.mappings.begin(), ob.mappings.end(), 
+                             make_pair(p, pi)));
+      object_of[p][pi] = -1;
+      if (get_present_bit(tables[p][pi]) == 1) {
+        clear_present_bit(tables[p][pi]);
+        pte_unmapped(o);
+      }
+      if (ob.mappings.empty()) {
+        if (ob.frame != -1) {
+          object_in[ob.frame] = -1;
+          free_frames.push_back(ob.frame);
+        }
+        free_objects.push_back(o);
+      }
+    }
+
+    // unmap the object in frame f from every pte, writing it out if dirty
+    void evict(int f) {
+      int o = object_in[f];
+      Object& ob = objects[o];
+      for (int i = 0; i < ob.mappings.size(); ++i) {
+        unsigned int& pte = tables[ob.mappings[i].first][ob.mappings[i].second];
+        if (get_present_bit(pte) == 1) {
+          clear_present_bit(pte);
+          clear_referenced_bit(pte);
+          clear_modified_bit(pte);
+          ++cnt_unmap;
+          pte_unmapped(o);
+        }
+      }
+      if (ob.dirty) {
+        ob.dirty = false;
+        ob.pagedout = true;
+        ++cnt_out;
+      }
+      ob.frame = -1;
+      object_in[f] = -1;
+    }
+
+    int get_frame() {
+      if (!free_frames.empty()) {
+        int f = free_frames.back();
+        free_frames.pop_back();
+        return f;
+      }
+      if (next_frame < frame_limit) {
+        return next_frame++;
+      }
+
+      while (true) {
+        int f = hand;
+        hand = (hand + 1) % frame_limit;
+        if (object_in[f] == -1 || f == pinned) {
+          continue;
+        }
+
+        bool referenced = false;
+        Object& ob = objects[object_in[f]];
+        for (int i = 0; i < ob.mappings.size(); ++i) {
+          unsigned int& pte = 
+            tables[ob.mappings[i].first][ob.mappings[i].second];
+          if (get_present_bit(pte) == 1 && get_referenced_bit(pte) == 1) {
+            clear_referenced_bit(pte);
+            referenced = true;
+          }
+        }
+        if (!referenced) {
+          evict(f);
+          return f;
+        }
+      }
+    }
+
+    void place(int o) {
+      int f = get_frame();
+      objects[o].frame = f;
+      object_in[f] = o;
+    }
+
+    // bring object o into a frame
+    void load(int o) {
+      place(o);
+      if (objects[o].pagedout) {
+        ++cnt_in;
+      } 
+      else {
+        ++cnt_zero;
+      }
+    }
+
+  public:
+    ForkVMM(int num_of_frames) {
+      frame_limit = num_of_frames;
+      next_frame = 0;
+      object_in = vector<int>(num_of_frames, -1);
+      hand = 0;
+      pinned = -1;
+      pid = 0;
+      ensure_process(0);
+      cnt_inst = cnt_unmap = cnt_map = cnt_in = cnt_out = cnt_zero = 0;
+      cnt_cow = cnt_fork = cnt_exit = 0;
+      cnt_saved = 0;
+      sum_saved = 0;
+      max_saved = 0;
+    }
+
+    void map_page_frame(unsigned int rw, unsigned int pi) {
+      unsigned int& pte = tables[pid][pi];
+      int o = object_of[pid][pi];
+
+      if (get_present_bit(pte) == 0) {
+        if (o == -1) {
+          o = new_object(false);
+          attach(o, pid, pi);
+        }
+        // in memory already if another process has it mapped
+        if (objects[o].frame == -1) {
+          load(o);
+        }
+        set_frame_number(pte, objects[o].frame);
+        set_present_bit(pte);
+        pte_mapped(o);
+        ++cnt_map;
+      }
+      set_referenced_bit(pte);
+
+      if (rw == 1) {
+        if (get_cow_bit(pte) == 1) {
+          if (objects[o].mappings.size() > 1) {
+            // copy it into a frame of its own
+            pinned = objects[o].frame;
+            detach(pid, pi);
+            o = new_object(false);
+            attach(o, pid, pi);
+            place(o);
+            pinned = -1;
+            set_frame_number(pte, objects[o].frame);
+            set_present_bit(pte);
+            pte_mapped(o);
+            ++cnt_cow;
+          }
+          clear_cow_bit(pte);
+        }
+        set_modified_bit(pte);
+        objects[o].dirty = true;
+      }
+
+      ++cnt_inst;
+      sum_saved += cnt_saved;
+      max_saved = max(max_saved, cnt_saved);
+    }
+
+    // the current process forks process child, which shares all its 
+    // pages: copy on write, except for the shared mappings
+    void fork(int child) {
+      ensure_process(child);
+      for (int pi = 0; pi < 64; ++pi) {
+        if (object_of[child][pi] != -1) {
+          detach(child, pi);
+        }
+      }
+
+      for (int pi = 0; pi < 64; ++pi) {
+        int o = object_of[pid][pi];
+        unsigned int pte = tables[pid][pi];
+        if (o == -1) {
+          tables[child][pi] = pte;
+          continue;
+        }
+        if (!objects[o].shared) {
+          set_cow_bit(tables[pid][pi]);
+          set_cow_bit(pte);
+        }
+        clear_referenced_bit(pte);
+        tables[child][pi] = pte;
+        attach(o, child, pi);
+        // a present pte is a mapping made, as eviction unmaps every one
+        if (get_present_bit(pte) == 1) {
+          pte_mapped(o);
+          ++cnt_map;
+        }
+      }
+      ++cnt_fork;
+    }
+
+    // the current process exits, releasing its pages
+    void exit() {
+      for (int pi = 0; pi < 64; ++pi) {
+        if (object_of[pid][pi] != -1) {
+          detach(pid, pi);
+        }
+        tables[pid][pi] = 0;
+      }
+      ++cnt_exit;
+    }
+
+    void switch_to(int p) {
+      ensure_process(p);
+      pid = p;
+    }
+
+    // page pi of the current process is a shared mapping
+    void map_shared(int pi) {
+      int o = object_of[pid][pi];
+      if (o == -1) {
+        o = new_object(true);
+        attach(o, pid, pi);
+      }
+      objects[o].shared = true;
+    }
+
+    void print_summary() {
+      printf("SUM %lld U=%lld M=%lld I=%lld O=%lld Z=%lld C=%lld ===> %llu\n",
+             cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero, 
+             cnt_cow, get_cost(cnt_inst, cnt_unmap, cnt_map, cnt_in, 
+                               cnt_out, cnt_zero) + cost_model.copy * cnt_cow);
+      printf("FORK processes=%d forks=%lld exits=%lld COW=%lld "
+             "saved frames avg=%.2lf max=%d\n", (int)tables.size(), 
+             cnt_fork, cnt_exit, cnt_cow, 
+             cnt_inst == 0 ? 0.0 : (double)sum_saved / cnt_inst, max_saved);
+    }
+};
 
-            if (O) {
-              printf("%d: ZERO     %4d\n", cnt_inst, frame_number);
-            }
-            ++cnt_zero;
-          }
+/*
+ * a text trace with fork records, for -F:
+ *   <rw> <page>   reference by the current process
+ *   f <pid>       fork process pid
+ *   s <pid>       switch to process pid
+ *   e             exit the current process
+ *   m <page>      page is a shared mapping of the current process
+ */
+bool run_fork_trace(const char* name, ForkVMM& v) {
+  FILE* file = fopen(name, "r");
+  if (file == NULL) {
+    return false;
+  }
+  char buf[256];
+  while (fgets(buf, sizeof(buf), file) != NULL) {
+    int x, y;
+    if (buf[0] == '#') {
+      continue;
+    }
+    if (sscanf(buf, "%d %d", &x, &y) == 2) {
+      if (y >= 0 && y <= 63) {
+        v.map_page_frame(x == 1, y);
+      }
+    } 
+    else if (sscanf(buf, " f %d", &x) == 1 && x >= 0) {
+      v.fork(x);
+    } 
+    else if (sscanf(buf, " s %d", &x) == 1 && x >= 0) {
+      v.switch_to(x);
+    } 
+    else if (sscanf(buf, " m %d", &x) == 1 && x >= 0 && x <= 63) {
+      v.map_shared(x);
+    } 
+    else if (buf[strspn(buf, " \t")] == 'e') {
+      v.exit();
+    }
+  }
+  fclose(file);
+  return true;
+}
 
-          if (O) {
-            printf("%d: MAP  %4d%4d\n", cnt_inst, pi, frame_number);
-          }
-          ++cnt_map;
+/*
+ * huge pages (-H). Aligned groups of N pages can be mapped through one 
+ * entry to N contiguous frames starting at a multiple of N. Faults map 
+ * base pages; every interval references a khugepaged scan promotes the 
+ * groups whose N pages are all present and were all referenced since the
+ * last scan: in place if they already sit in order in an aligned block, 
+ * else by copying them into the block holding the fewest pages (evicting
+ * those). A huge entry has one R and one M bit for the group, so the 
+ * clock skips its whole block while it is referenced. Evicting one of its
+ * pages demotes it back to base pages first.
+ */
+class HugeVMM {
+  private:
+    int n; // pages per huge page
+    int interval; // references between two scans
+    vector<unsigned int> pages;
+    vector<int> rev_frames;
+    vector<bool> huge; // per group
+    vector<bool> touched; // referenced since the last scan
+    int frame_limit, num_of_blocks;
+    int next_frame;
+    vector<int> free_frames;
+    int hand;
+    TLB* tlb;
+
+    long long cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero;
+    int cnt_promote, cnt_in_place, cnt_copy, cnt_demote, cnt_failed;
+    int cnt_resident, cnt_huge_pages; // resident pages, in huge mappings
+    long long cnt_huge_refs, sum_coverage;
+    long long cnt_scans, sum_free, sum_free_in_blocks;
+
+    int group_of(int pi) const {
+      return pi / n;
+    }
 
-          set_frame_number(pte, frame_number);
-          rev_frames[frame_number] = pi;
-        }
+    // TLB tag of page pi: its page, or one tag for a whole huge page
+    int tag_of(int pi) const {
+      int g = group_of(pi);
+      return huge[g] ? pages.size() + g : pi;
+    }
 
-        // set respective bit
-        set_present_bit(pte);
-        if (rw == 0) {
-          set_referenced_bit(pte);
-        } 
-        else {
-          set_referenced_bit(pte);
-          set_modified_bit(pte);
-        }
+    void demote(int g) {
+      huge[g] = false;
+      cnt_huge_pages -= n;
+      ++cnt_demote;
+      if (tlb != NULL) {
+        tlb->shootdown(pages.size() + g);
+      }
+    }
 
-      } // if the corresponding entry is already in the frame table
-      else {
-        algo->update(frames, get_frame_number(pte));
-        if (rw == 0) {
-          set_referenced_bit(pte);
+    void evict(int f) {
+      int pi = rev_frames[f];
+      if (huge[group_of(pi)]) {
+        demote(group_of(pi));
+      }
+      ++cnt_unmap;
+      if (tlb != NULL) {
+        tlb->shootdown(pi);
+      }
+      if (get_modified_bit(pages[pi]) == 1) {
+        set_pagedout_bit(pages[pi]);
+        ++cnt_out;
+      }
+      clear_present_bit(pages[pi]);
+      clear_referenced_bit(pages[pi]);
+      clear_modified_bit(pages[pi]);
+      rev_frames[f] = -1;
+      --cnt_resident;
+    }
+
+    // a frame never used so far, a free frame, or one taken by the clock
+    int get_frame() {
+      if (!free_frames.empty()) {
+        int f = free_frames.back();
+        free_frames.pop_back();
+        return f;
+      }
+      if (next_frame < frame_limit) {
+        return next_frame++;
+      }
+
+      while (true) {
+        int f = hand;
+        hand = (hand + 1) % frame_limit;
+        int pi = rev_frames[f];
+        if (pi == -1) {
+          continue;
+        }
+        int g = group_of(pi);
+        if (huge[g]) {
+          // one R bit for the block
+          bool referenced = false;
+          for (int i = g * n; i < (g + 1) * n; ++i) {
+            referenced |= get_referenced_bit(pages[i]) == 1;
+            clear_referenced_bit(pages[i]);
+          }
+          if (referenced) {
+            hand = (f - f % n + n) % frame_limit;
+            continue;
+          }
         } 
-        else {
-          set_referenced_bit(pte);
-          set_modified_bit(pte);
+        else if (get_referenced_bit(pages[pi]) == 1) {
+          clear_referenced_bit(pages[pi]);
+          continue;
         }
+        evict(f);
+        return f;
       }
-      ++cnt_inst;
+    }
 
-      // print virtual pages each cycle
-      if (p) {
-        for (int i = 0; i < pages.size(); ++i) {
-          if (get_present_bit(pages[i]) == 1) {
-            printf("%d:", i);
-            if (get_referenced_bit(pages[i]) == 1) {
-              printf("R");
-            } 
-            else {
-              printf("-");
-            }
+    void promote(int g) {
+      int first = get_frame_number(pages[g * n]);
+      bool in_order = first % n == 0;
+      for (int i = 1; i < n && in_order; ++i) {
+        in_order = get_frame_number(pages[g * n + i]) == first + i;
+      }
 
-            if (get_modified_bit(pages[i]) == 1) {
-              printf("M");
-            } 
-            else {
-              printf("-");
-            }
+      if (!in_order) {
+        // the block with the fewest pages, none of them of the group
+        int best = -1, best_used = n + 1;
+        for (int b = 0; b < num_of_blocks; ++b) {
+          int used = 0;
+          bool own = false;
+          for (int f = b * n; f < (b + 1) * n; ++f) {
+            used += (f < next_frame && rev_frames[f] != -1);
+            own |= (f < next_frame && rev_frames[f] != -1 && 
+                    group_of(rev_frames[f]) == g);
+          }
+          if (!own && used < best_used) {
+            best = b;
+            best_used = used;
+          }
+        }
+        if (best == -1) {
+          ++cnt_failed;
+          return;
+        }
 
-            if (get_pagedout_bit(pages[i]) == 1) {
-              printf("S ");
-            } 
-            else {
-              printf("- ");
-            }
+        for (int f = best * n; f < (best + 1) * n; ++f) {
+          if (f < next_frame && rev_frames[f] != -1) {
+            evict(f);
+          }
+          vector<int>::iterator it = 
+            find(free_frames.begin(), free_frames.end(), f);
+          if (it != free_frames.end()) {
+            free_frames.erase(it);
+          }
+        }
+        // frames never used below the block go to the free list
+        while (next_frame < (best + 1) * n) {
+          if (next_frame < best * n) {
+            free_frames.push_back(next_frame);
+          }
+          ++next_frame;
+        }
 
-          } 
-          else {
-            if (get_pagedout_bit(pages[i]) == 1) {
-              printf("# ");
-            } 
-            else {
-              printf("* ");
-            }
+        for (int i = 0; i < n; ++i) {
+          int pi = g * n + i;
+          int f = get_frame_number(pages[pi]);
+          rev_frames[f] = -1;
+          free_frames.push_back(f);
+          set_frame_number(pages[pi], best * n + i);
+          rev_frames[best * n + i] = pi;
+          if (tlb != NULL) {
+            tlb->shootdown(pi);
+          }
+          ++cnt_copy;
+        }
+      } 
+      else {
+        ++cnt_in_place;
+        for (int i = g * n; i < (g + 1) * n; ++i) {
+          if (tlb != NULL) {
+            tlb->shootdown(i);
           }
         }
-        printf("\n");
       }
 
-      // print phyical frames each cycle
-      if (f) {
-        for (int i = 0; i < rev_frames.size(); ++i) {
-          if (rev_frames[i] == -1) {
-            printf("* ");
-          } 
-          else {
-            printf("%d ", rev_frames[i]);
-          }
+      huge[g] = true;
+      cnt_huge_pages += n;
+      ++cnt_promote;
+    }
+
+    void scan() {
+      for (int g = 0; g < huge.size(); ++g) {
+        bool hot = !huge[g];
+        for (int i = g * n; i < (g + 1) * n && hot; ++i) {
+          hot = get_present_bit(pages[i]) == 1 && touched[i];
+        }
+        if (hot) {
+          promote(g);
         }
-        printf("\n");
       }
-    } // end map_page_frame
+      touched.assign(touched.size(), false);
+
+      // free frames outside of free blocks can't back a huge page
+      int free_in_blocks = 0;
+      for (int b = 0; b < num_of_blocks; ++b) {
+        bool all_free = true;
+        for (int f = b * n; f < (b + 1) * n; ++f) {
+          all_free &= (f >= next_frame || rev_frames[f] == -1);
+        }
+        free_in_blocks += all_free ? n : 0;
+      }
+      ++cnt_scans;
+      sum_free += frame_limit - cnt_resident;
+      sum_free_in_blocks += free_in_blocks;
+    }
 
+  public:
+    HugeVMM(int num_of_pages, int num_of_frames, int pages_per_huge, 
+            int scan_interval) {
+      n = pages_per_huge;
+      interval = scan_interval;
+      pages = vector<unsigned int>(num_of_pages, 0);
+      rev_frames = vector<int>(num_of_frames, -1);
+      huge = vector<bool>(num_of_pages / n, false);
+      touched = vector<bool>(num_of_pages, false);
+      frame_limit = num_of_frames;
+      num_of_blocks = num_of_frames / n;
+      next_frame = 0;
+      hand = 0;
+      tlb = NULL;
+      cnt_inst = cnt_unmap = cnt_map = cnt_in = cnt_out = cnt_zero = 0;
+      cnt_promote = cnt_in_place = cnt_copy = cnt_demote = cnt_failed = 0;
+      cnt_resident = cnt_huge_pages = 0;
+      cnt_huge_refs = sum_coverage = 0;
+      cnt_scans = sum_free = sum_free_in_blocks = 0;
+    }
 
-    void print_summary() {
-      if (P) {
-        for (int i = 0; i < pages.size(); ++i) {
-          if (get_present_bit(pages[i]) == 1) {
-            printf("%d:", i);
-            if (get_referenced_bit(pages[i]) == 1) {
-              printf("R");
-            } 
-            else {
-              printf("-");
-            }
+    void set_tlb(TLB* t) {
+      tlb = t;
+    }
 
-            if (get_modified_bit(pages[i]) == 1) {
-              printf("M");
-            } 
-            else {
-              printf("-");
-            }
+    void map_page_frame(unsigned int rw, unsigned int pi) {
+      int g = group_of(pi);
 
-            if (get_pagedout_bit(pages[i]) == 1) {
-              printf("S ");
-            } 
-            else {
-              printf("- ");
-            }
-          } 
-          else {
-            if (get_pagedout_bit(pages[i]) == 1) {
-              printf("# ");
-            } 
-            else {
-              printf("* ");
-            }
-          }
+      if (get_present_bit(pages[pi]) == 0) {
+        int f = get_frame();
+        if (get_pagedout_bit(pages[pi]) == 1) {
+          ++cnt_in;
+        } 
+        else {
+          ++cnt_zero;
         }
-        printf("\n");
+        ++cnt_map;
+        set_frame_number(pages[pi], f);
+        set_present_bit(pages[pi]);
+        rev_frames[f] = pi;
+        ++cnt_resident;
       }
-      if (F) {
-        for (int i = 0; i < rev_frames.size(); ++i) {
-          if (rev_frames[i] == -1) {
-            printf("* ");
-          } 
-          else {
-            printf("%d ", rev_frames[i]);
-          }
+
+      // a huge entry has one R and one M bit
+      int from = huge[g] ? g * n : pi, to = huge[g] ? (g + 1) * n : pi + 1;
+      for (int i = from; i < to; ++i) {
+        set_referenced_bit(pages[i]);
+        if (rw == 1) {
+          set_modified_bit(pages[i]);
         }
-        printf("\n");
       }
-      if (S) {
-        unsigned long long cost;
+      touched[pi] = true;
+      cnt_huge_refs += huge[g];
 
-        cost = (long long)cnt_inst + 400 * (long long)(cnt_map + cnt_unmap) + 
-          3000 * (long long)(cnt_in + cnt_out) + 150 * (long long)cnt_zero;
+      if (tlb != NULL) {
+        tlb->translate(tag_of(pi));
+      }
 
-        printf("SUM %d U=%d M=%d I=%d O=%d Z=%d ===> %llu\n",
-               cnt_inst, cnt_unmap, cnt_map, cnt_in,
-               cnt_out, cnt_zero, cost);
+      ++cnt_inst;
+      sum_coverage += cnt_huge_pages;
+      if (cnt_inst % interval == 0) {
+        scan();
       }
     }
-};
-
-void read_random_file(string s, vector<int>& rand_nums, int& count_random) {
-  ifstream fin;
-  fin.open(s.c_str());
-  string line;
 
-  if (fin.is_open()) {
-    getline(fin,line);
-    count_random = atoi(line.c_str());
-    while (getline(fin, line)) {
-      rand_nums.push_back(atoi(line.c_str()));
+    void print_summary() {
+      printf("SUM %lld U=%lld M=%lld I=%lld O=%lld Z=%lld ===> %llu\n",
+             cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, cnt_zero, 
+             get_cost(cnt_inst, cnt_unmap, cnt_map, cnt_in, cnt_out, 
+                      cnt_zero) + cost_model.copy * cnt_copy + 
+             (tlb != NULL ? tlb->get_cost() : 0));
+      if (tlb != NULL) {
+        tlb->print_summary();
+      }
+      printf("HUGE %d pages promotions=%d (in place %d) copies=%d "
+             "demotions=%d failed=%d huge refs=%.2lf%% huge frames=%.2lf%% "
+             "unusable free=%.2lf%%\n", n, cnt_promote, cnt_in_place, 
+             cnt_copy, cnt_demote, cnt_failed, 
+             cnt_inst == 0 ? 0.0 : 100.0 * cnt_huge_refs / cnt_inst,
+             cnt_inst == 0 ? 0.0 : 100.0 * sum_coverage / cnt_inst / 
+                                   frame_limit,
+             sum_free == 0 ? 0.0 : 
+               100.0 * (sum_free - sum_free_in_blocks) / sum_free);
     }
-  }
-  else {
-    fprintf(stderr, "Unable to open random file\n");
-  }
-  fin.close();
-}
+};
 
+/*
+ * a run of the VMM over the whole trace with the options of main
+ */
+class Simulation {
+  public:
+    TraceReader* trace;
+    vector<int> rand_nums;
+    int count_random;
+    int num_of_frames;
+    bool O, P, F, S, p, f, a, T;
+    TLB* tlb;
+    Zswap* zswap;
+    Numa* numa;
+    const char* profile_name; // write the page profile there
+    int readahead, region_size;
+    int low_wm, high_wm;
+
+    template <class Algo>
+    void operator()(Algo* algo) {
+      // OPT looks ahead, so it replays the trace from memory
+      vector<unsigned int> refs;
+      if (needs_trace(algo)) {
+        load_trace(trace, refs);
+        set_trace(algo, refs);
+        delete trace;
+        trace = new Reader_Memory(refs);
+      }
 
-void get_next_instruction(unsigned int& rw, unsigned int& pi, FILE** f) {
-  FILE *infile = *f;
-  char buf[1000];
-  fgets(buf, 1000, infile);
+      algo->set_random(rand_nums, count_random);
+      algo->set_num_of_frames(num_of_frames);
 
-  if (feof(infile) || buf[0] == '#') {
-    rw = pi = -1;
-  } 
-  else {
-    sscanf(buf, "%d%d", &rw, &pi);
-    if (pi < 0 || pi > 63) {
-      fprintf(stderr, "Virtual page index is out of range\n");
+      VMM<Algo> v(algo, num_of_frames, O, P, F, S, p, f, a);
+      v.set_tlb(tlb);
+      v.set_zswap(zswap);
+      if (numa != NULL) {
+        v.set_numa(numa);
+      }
+      SwapDevice* device = NULL;
+      if (cost_model.swap_depth > 0) {
+        device = new SwapDevice();
+        v.set_device(device);
+      }
+      if (readahead > 0) {
+        v.set_readahead(readahead, region_size);
+      }
+      v.set_watermarks(low_wm, high_wm);
+      PageProfile* profile = NULL;
+      if (profile_name != NULL) {
+        profile = new PageProfile(64);
+        v.set_profile(profile);
+      }
+
+      unsigned int rw, pi;
+      long long n = 0;
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      while (get_next_instruction(rw, pi, trace)) {
+        if (numa != NULL) {
+          v.set_cpu_node(trace->get_node() %
+                         (unsigned int)numa->get_num_of_nodes());
+        }
+        v.map_page_frame(rw, pi);
+        ++n;
+      }
+      double secs = chrono::duration<double>(chrono::steady_clock::now() - 
+                                             start).count();
+    
+      v.print_summary();
+      if (T) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        printf("TIME %.3lfs %.0lf refs/sec %.0lf faults/sec %ldKB peak RSS\n",
+               secs, n / secs, v.get_num_of_faults() / secs, 
+               usage.ru_maxrss);
+      }
+      if (profile != NULL && !profile->write(profile_name)) {
+        fprintf(stderr, "Unable to write profile %s\n", profile_name);
+      }
+      delete device;
+      delete profile;
+      delete algo;
     }
-  }
-}
+};
 
 int main(int argc, char* argv[]) {
 
+    // the dumps of -o write a lot of small pieces
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
     int num_of_frames; // size of frame table
-    bool O, P, F, S, p, f, a;
-    Pager* algo; // page replacement algorithm used
+    bool O, P, F, S, p, f, a, T;
+    const char* algo = "l"; // page replacement algorithm used
+    bool algo_given = false; // -a, which the clock only modes reject
     unsigned int rw, pi;
     int count_random;
     vector<int> rand_nums;
-
-    FILE* infile = NULL;
+    char* bin_name = NULL; // convert the trace into this binary file
+    bool mrc = false; // lru fault counts for every number of frames
+    double rate = 1; // share of the pages sampled by -m and -s
+    bool sweep = false; // run every algo with every number of frames
+    const char* thread_list = NULL; // numbers of threads sharing memory
+    bool fork_mode = false; // processes forking and sharing pages
+    int huge_pages = 0; // pages per huge page
+    int scan_interval = 100; // references between khugepaged scans
+    const char* algos = "NlrfscXaY"; // algos of the sweep
+    const char* frame_list = "32"; // numbers of frames of the sweep
+    int num_of_threads = thread::hardware_concurrency();
+    const char* tlb_spec = NULL; // TLB in front of the page table
+    TLB* tlb = NULL;
+    const char* zswap_spec = NULL; // compressed pool in front of swap
+    Zswap* zswap = NULL;
+    const char* numa_spec = NULL; // memory nodes
+    Numa* numa = NULL;
+    const char* profile_name = NULL; // per page counts and reuse distances
+    int readahead = 0; // pages read ahead on a strided fault
+    int region_size = 8; // pages per region of the stride detection
+    int low_wm = 0, high_wm = 0; // free frame watermarks of kswapd
+
+    TraceReader* trace = NULL;
     num_of_frames = 32;
-    O = P = F = S = p = f = a = false;
-    algo = new Pager_LRU();
+    O = P = F = S = p = f = a = T = false;
 
     // parse optional arguments
     int c;
     int optlen;
-    while ((c = getopt(argc, argv, "a:o:f:")) != -1) {
+    Pager* probe;
+    while ((c = getopt(argc, argv, "a:o:f:b:msj:t:r:k:S:c:Fz:n:C:h:H:")) != -1) {
       switch (c) {
         // set algorithm 
         case 'a':
-          switch (optarg[0]) {
-            case 'N': algo = new Pager_NRU(); break;
-            case 'l': algo = new Pager_LRU(); break;
-            case 'r': algo = new Pager_Random(); break;
-            case 'f': algo = new Pager_FIFO(); break;
-            case 's': algo = new Pager_SecondChance(); break;
-            case 'c': algo = new Pager_Clock_P(); break;
-            case 'X': algo = new Pager_Clock_V(); break;
-            case 'a': algo = new Pager_Aging_P(); break;
-            case 'Y': algo = new Pager_Aging_V(); break;
-            default: break;
+          if ((probe = new_pager(optarg[0], optarg + 1)) != NULL) {
+            delete probe;
+            algo = optarg;
           }
+          algos = optarg;
+          algo_given = true;
           break;
           // set options
         case 'o':
@@ -714,47 +4510,389 @@ int main(int argc, char* argv[]) {
               case 'p': p = true; break;
               case 'f': f = true; break;
               case 'a': a = true; break;
+              case 'T': T = true; break;
             }
           }
           break;
           // set number of frames
         case 'f':
           sscanf(optarg, "%d", &num_of_frames);
+          frame_list = optarg;
+          break;
+          // convert the trace to the binary format
+        case 'b':
+          bin_name = optarg;
+          break;
+          // lru miss ratio curve
+        case 'm':
+          mrc = true;
+          break;
+          // sweep over algos and numbers of frames
+        case 's':
+          sweep = true;
+          break;
+        case 'j':
+          sscanf(optarg, "%d", &num_of_threads);
+          break;
+          // threads sharing one page table
+        case 'c':
+          thread_list = optarg;
+          break;
+          // processes forking and sharing pages
+        case 'F':
+          fork_mode = true;
+          break;
+          // approximate -m and -s on the sampled pages
+        case 'S':
+          sscanf(optarg, "%lf", &rate);
+          mrc = true;
+          break;
+          // simulate a TLB
+        case 't':
+          tlb_spec = optarg;
+          break;
+          // compressed swap cache
+        case 'z':
+          zswap_spec = optarg;
+          break;
+          // huge pages
+        case 'H':
+          sscanf(optarg, "%d:%d", &huge_pages, &scan_interval);
+          break;
+          // page profile
+        case 'h':
+          profile_name = optarg;
+          break;
+          // cost model file
+        case 'C':
+          if (!cost_model.load(optarg)) {
+            abort();
+          }
+          break;
+          // NUMA nodes
+        case 'n':
+          numa_spec = optarg;
+          break;
+          // readahead
+        case 'r':
+          sscanf(optarg, "%d:%d", &readahead, &region_size);
+          break;
+          // background reclaim
+        case 'k':
+          if (sscanf(optarg, "%d:%d", &low_wm, &high_wm) != 2) {
+            high_wm = low_wm;
+          }
           break;
       }
     }
 
-    if (num_of_frames > 64) {
-      fprintf(stderr, "Max. number of frames can't be greater than 64\n");
+    if (bin_name != NULL) {
+      return convert_trace(argv[argc - 1], bin_name);
+    }
+
+    if (!(rate > 0 && rate <= 1)) {
+      fprintf(stderr, "Invalid sampling rate %g\n", rate);
+      abort();
+    }
+    // the frames of the sampled runs are scaled down, the watermarks not
+    if (rate < 1 && sweep && low_wm > 0) {
+      fprintf(stderr, "Watermarks can't be used with sampling\n");
+      abort();
+    }
+    if (low_wm < 0 || high_wm < low_wm) {
+      fprintf(stderr, "Invalid watermarks %d:%d\n", low_wm, high_wm);
+      abort();
+    }
+    if (readahead < 0 || region_size < 1) {
+      fprintf(stderr, "Invalid readahead %d:%d\n", readahead, region_size);
+      abort();
+    }
+    // OPT only knows the future of the referenced page
+    if (readahead > 0 && 
+        (sweep ? strchr(algos, 'O') != NULL : algo[0] == 'O')) {
+      fprintf(stderr, "Readahead can't be used with OPT\n");
       abort();
     }
 
-    infile = fopen(argv[argc - 2], "r");
+    if (tlb_spec != NULL && (tlb = new_tlb(tlb_spec)) == NULL) {
+      fprintf(stderr, "Invalid TLB %s\n", tlb_spec);
+      abort();
+    }
+    if (zswap_spec != NULL && (zswap = new_zswap(zswap_spec)) == NULL) {
+      fprintf(stderr, "Invalid zswap %s\n", zswap_spec);
+      abort();
+    }
+    if (numa_spec != NULL && (numa = new_numa(numa_spec)) == NULL) {
+      fprintf(stderr, "Invalid NUMA %s\n", numa_spec);
+      abort();
+    }
+    // the node column is only read on single runs streaming a text trace
+    if (numa != NULL && 
+        (sweep || mrc || fork_mode || thread_list != NULL || 
+         algo[0] == 'O')) {
+      fprintf(stderr, "NUMA can only be used on single runs without OPT\n");
+      abort();
+    }
 
-    if (infile == NULL) {
-      fprintf(stderr, "Unable to open input file\n");
+    // -c, -F and -H run their own clock VMMs, which have no pager,
+    // zswap, readahead, kswapd, swap device, profile nor dumps, and only
+    // the one of -H has a TLB
+    string unsupported;
+    if (algo_given) {
+      unsupported += " -a";
+    }
+    if (O || P || F || p || f || a || T) {
+      unsupported += " -o";
+    }
+    if (zswap_spec != NULL) {
+      unsupported += " -z";
+    }
+    if (readahead > 0) {
+      unsupported += " -r";
+    }
+    if (high_wm > 0) {
+      unsupported += " -k";
+    }
+    if (cost_model.swap_depth > 0) {
+      unsupported += " -C swap_depth";
+    }
+    if (profile_name != NULL) {
+      unsupported += " -h";
+    }
+    string runs;
+    if (sweep) {
+      runs += " -s";
+    }
+    if (mrc) {
+      runs += rate < 1 ? " -S" : " -m";
+    }
+    if (fork_mode) {
+      string bad = unsupported + runs;
+      if (tlb_spec != NULL) {
+        bad += " -t";
+      }
+      if (thread_list != NULL) {
+        bad += " -c";
+      }
+      if (huge_pages > 0) {
+        bad += " -H";
+      }
+      if (!bad.empty()) {
+        fprintf(stderr, "-F can't be used with%s\n", bad.c_str());
+        abort();
+      }
+    }
+    if (huge_pages > 0) {
+      string bad = unsupported + runs;
+      if (thread_list != NULL) {
+        bad += " -c";
+      }
+      if (numa_spec != NULL) {
+        bad += " -n";
+      }
+      if (!bad.empty()) {
+        fprintf(stderr, "-H can't be used with%s\n", bad.c_str());
+        abort();
+      }
+    }
+    if (thread_list != NULL) {
+      string bad = unsupported + runs;
+      if (tlb_spec != NULL) {
+        bad += " -t";
+      }
+      if (!bad.empty()) {
+        fprintf(stderr, "-c can't be used with%s\n", bad.c_str());
+        abort();
+      }
+    }
+    // a sweep prints one SUM line per run
+    if (sweep && (O || P || F || p || f || a || T || profile_name != NULL)) {
+      fprintf(stderr, "-s can't be used with -h nor the -o dumps\n");
       abort();
     }
+    // -m, and -S without -s, only count LRU stack distances
+    if (mrc && (rate == 1 || !sweep)) {
+      string bad = unsupported;
+      if (tlb_spec != NULL) {
+        bad += " -t";
+      }
+      if (sweep) {
+        bad += " -s";
+      }
+      if (!bad.empty()) {
+        fprintf(stderr, "%s can't be used with%s\n", 
+                rate < 1 ? "-S" : "-m", bad.c_str());
+        abort();
+      }
+    }
+
+    if (huge_pages > 0) {
+      if (huge_pages < 2 || (huge_pages & (huge_pages - 1)) != 0 ||
+          num_of_frames < huge_pages || num_of_frames > 64 || 
+          scan_interval < 1) {
+        fprintf(stderr, "Invalid huge pages %d:%d with %d frames\n", 
+                huge_pages, scan_interval, num_of_frames);
+        abort();
+      }
+      trace = open_trace(argv[argc - 2]);
+      if (trace == NULL) {
+        fprintf(stderr, "Unable to open input file\n");
+        abort();
+      }
+      HugeVMM v(64, num_of_frames, huge_pages, scan_interval);
+      v.set_tlb(tlb);
+      while (get_next_instruction(rw, pi, trace)) {
+        v.map_page_frame(rw, pi);
+      }
+      v.print_summary();
+      delete trace;
+      return 0;
+    }
+
+    if (fork_mode) {
+      // a copy on write needs the frame copied from and a frame to copy to
+      if (num_of_frames < 2 || num_of_frames > 64) {
+        fprintf(stderr, "Fork mode needs 2 to 64 frames\n");
+        abort();
+      }
+      ForkVMM v(num_of_frames);
+      if (!run_fork_trace(argv[argc - 2], v)) {
+        fprintf(stderr, "Unable to open input file\n");
+        abort();
+      }
+      v.print_summary();
+      return 0;
+    }
 
-    read_random_file(argv[argc - 1], rand_nums, count_random);
-    algo->set_random(rand_nums, count_random);
-    algo->set_num_of_frames(num_of_frames);
+    if (thread_list != NULL) {
+      vector<int> thread_counts;
+      if (!parse_frame_list(thread_list, thread_counts)) {
+        fprintf(stderr, "Invalid list of threads\n");
+        abort();
+      }
+      if (num_of_frames < 1 || num_of_frames > 64) {
+        fprintf(stderr, 
+                "Max. number of frames can't be greater than 64\n");
+        abort();
+      }
 
-    VMM v = VMM(algo, num_of_frames, O, P, F, S, p, f, a);
+      // every argument up to the rfile is a trace
+      vector<vector<unsigned int> > traces;
+      for (int i = optind; i < argc - 1; ++i) {
+        trace = open_trace(argv[i]);
+        if (trace == NULL) {
+          fprintf(stderr, "Unable to open input file\n");
+          abort();
+        }
+        traces.push_back(vector<unsigned int>());
+        load_trace(trace, traces.back());
+        delete trace;
+      }
+      if (traces.empty()) {
+        fprintf(stderr, "No input file\n");
+        abort();
+      }
+      run_shared(traces, num_of_frames, thread_counts);
+      return 0;
+    }
 
-    while(!feof(infile)) {
-      get_next_instruction(rw, pi, &infile);
+    if (sweep) {
+      vector<int> frame_counts;
+      if (!parse_frame_list(frame_list, frame_counts)) {
+        fprintf(stderr, "Invalid list of frames\n");
+        abort();
+      }
 
-      // not a instruction line
-      if (rw == -1 && pi == -1) continue;
+      read_random_file(argv[argc - 1], rand_nums, count_random);
+
+      Sweep w(argv[argc - 2], rand_nums, count_random);
+      w.set_sampling(rate);
+      w.set_tlb(tlb_spec);
+      w.set_zswap(zswap_spec);
+      w.set_readahead(readahead, region_size);
+      w.set_watermarks(low_wm, high_wm);
+      if (!w.load()) {
+        fprintf(stderr, "Unable to open input file\n");
+        abort();
+      }
 
-      v.map_page_frame(rw, pi);
+      for (int i = 0; algos[i] != '\0'; ++i) {
+        for (int j = 0; j < frame_counts.size(); ++j) {
+          probe = new_pager(algos[i], "");
+          if (probe == NULL) {
+            fprintf(stderr, "Unknown algo %c\n", algos[i]);
+            abort();
+          }
+          delete probe;
+          if (frame_counts[j] < 1) {
+            fprintf(stderr, "Number of frames must be at least 1\n");
+            abort();
+          }
+          if (frame_counts[j] > 64) {
+            fprintf(stderr, 
+                    "Max. number of frames can't be greater than 64\n");
+            abort();
+          }
+          if (high_wm >= frame_counts[j]) {
+            fprintf(stderr, "High watermark must be below %d frames\n",
+                    frame_counts[j]);
+            abort();
+          }
+          w.add(algos[i], frame_counts[j]);
+        }
+      }
+      w.run(max(num_of_threads, 1));
+      return 0;
     }
-    
-    v.print_summary();
 
-    if (infile != NULL) {
-      fclose(infile);
+    if (num_of_frames < 1) {
+      fprintf(stderr, "Number of frames must be at least 1\n");
+      abort();
+    }
+    if (num_of_frames > 64) {
+      fprintf(stderr, "Max. number of frames can't be greater than 64\n");
+      abort();
+    }
+    if (high_wm >= num_of_frames) {
+      fprintf(stderr, "High watermark must be below %d frames\n", 
+              num_of_frames);
+      abort();
+    }
+
+    trace = open_trace(argv[argc - 2]);
+
+    if (trace == NULL) {
+      fprintf(stderr, "Unable to open input file\n");
+      abort();
     }
+
+    if (mrc) {
+      MissRatioCurve curve(64, 64, rate);
+      while (get_next_instruction(rw, pi, trace)) {
+        curve.access(rw, pi);
+      }
+      curve.print_summary();
+      delete trace;
+      return 0;
+    }
+
+    Simulation sim;
+    sim.trace = trace;
+    read_random_file(argv[argc - 1], sim.rand_nums, sim.count_random);
+    sim.num_of_frames = num_of_frames;
+    sim.O = O; sim.P = P; sim.F = F; sim.S = S;
+    sim.p = p; sim.f = f; sim.a = a; sim.T = T;
+    sim.tlb = tlb;
+    sim.zswap = zswap;
+    sim.numa = numa;
+    sim.profile_name = profile_name;
+    sim.readahead = readahead;
+    sim.region_size = region_size;
+    sim.low_wm = low_wm;
+    sim.high_wm = high_wm;
+
+    with_pager(algo[0], algo + 1, sim);
+
+    delete sim.trace;
     return 0;
 }
@@ -0,0 +1,123 @@
+// ARC under kswapd (-k -aA): kswapd takes frames with get_frame while
+// the referenced page is resident. That is no miss, so it must only turn
+// the victim into a ghost, leaving p and the other ghosts as they are.
+// Built and run by 'make check'.
+#define main mmu_main
+#define private public
+#include "mmu.cpp"
+#undef private
+#undef main
+
+int failures = 0;
+
+void expect(bool ok, const char* what, Pager_ARC& arc) {
+  PageLists& l = arc.lists;
+  if (!ok) {
+    printf("FAIL %s: T1=%d T2=%d B1=%d B2=%d p=%d\n", what, 
+           l.size(Pager_ARC::T1), l.size(Pager_ARC::T2), 
+           l.size(Pager_ARC::B1), l.size(Pager_ARC::B2), arc.p);
+    ++failures;
+  }
+}
+
+// the VMM's fault path on c frames, without the counting
+class Driver {
+  public:
+    Pager_ARC arc;
+    PageTable pages;
+    vector<unsigned int> frames, rev_frames;
+    int t, next_free;
+
+    Driver(int c) : pages(64, c) {
+      arc.set_random(vector<int>(1, 0), 1);
+      arc.set_num_of_frames(c);
+      rev_frames = vector<unsigned int>(c, -1);
+      t = next_free = 0;
+    }
+
+    void ref(unsigned int pi) {
+      arc.set_reference(t++, pi);
+      if (!get_present_bit(pages[pi])) {
+        int f = next_free < rev_frames.size() ? next_free++ : 
+                arc.get_frame(pages, frames, rev_frames);
+        if (rev_frames[f] != (unsigned int)-1) {
+          pages.clear_present(rev_frames[f]);
+        }
+        pages.set_frame(pi, f);
+        pages.set_present(pi);
+        rev_frames[f] = pi;
+      }
+      arc.update(frames, get_frame_number(pages[pi]));
+    }
+
+    // what reclaim does after the reference to pi
+    void reclaim(unsigned int pi) {
+      arc.set_reference(t++, pi);
+      int f = arc.get_frame(pages, frames, rev_frames);
+      pages.clear_present(rev_frames[f]);
+      rev_frames[f] = -1;
+      arc.release(frames, f);
+    }
+};
+
+int main() {
+  // T1 fills all the frames: the victim goes to B1
+  Driver d(4);
+  for (int pi = 0; pi < 4; ++pi) {
+    d.ref(pi);
+  }
+  d.reclaim(3);
+  PageLists& l = d.arc.lists;
+  expect(l.size(Pager_ARC::T1) == 3 && l.size(Pager_ARC::B1) == 1 && 
+         d.arc.p == 0, "reclaim with T1 full", d.arc);
+
+  // T1 + B1 fill the cache: B1 keeps its ghosts
+  Driver e(4);
+  for (int pi = 0; pi < 5; ++pi) {
+    e.ref(pi);
+  }
+  e.ref(4);
+  int b1 = e.arc.lists.size(Pager_ARC::B1);
+  int p = e.arc.p;
+  e.reclaim(4);
+  expect(e.arc.lists.size(Pager_ARC::B1) + 
+         e.arc.lists.size(Pager_ARC::B2) == b1 + 1 && e.arc.p == p,
+         "reclaim with T1 + B1 full", e.arc);
+
+  // and the lists stay bounded over random runs of the VMM with kswapd
+  srand(1);
+  vector<int> rand_nums(100, 0);
+  for (int iter = 0; iter < 200; ++iter) {
+    int c = 4 + rand() % 29;
+    int high = 1 + rand() % (c - 1);
+    int low = 1 + rand() % high;
+    int num_of_pages = 1 + rand() % 64;
+
+    Pager_ARC* arc = new Pager_ARC();
+    arc->set_random(rand_nums, rand_nums.size());
+    arc->set_num_of_frames(c);
+    VMM<Pager_ARC> v(arc, c, false, false, false, false, false, false, 
+                     false);
+    v.set_watermarks(low, high);
+    if (rand() % 2) {
+      v.set_readahead(1 + rand() % 4, 8);
+    }
+    for (int t = 0; t < 5000 && failures == 0; ++t) {
+      v.map_page_frame(rand() % 2, rand() % 4 ? 
+                       rand() % (num_of_pages / 4 + 1) : 
+                       rand() % num_of_pages);
+      PageLists& l = arc->lists;
+      int t1 = l.size(Pager_ARC::T1), t2 = l.size(Pager_ARC::T2);
+      int b1 = l.size(Pager_ARC::B1), b2 = l.size(Pager_ARC::B2);
+      expect(t1 + t2 == c - v.num_of_free_frames() && t1 + b1 <= c && 
+             t1 + t2 + b1 + b2 <= 2 * c && arc->p >= 0 && arc->p <= c,
+             "bounds with kswapd", *arc);
+    }
+    delete arc;
+  }
+
+  if (failures == 0) {
+    printf("ARC with kswapd: ok\n");
+  }
+  return failures != 0;
+}
@@ -0,0 +1,34 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <vector>
+
+/*
+ * binary trace format, written by mmu -b and tracegen -b and read by mmu:
+ *
+ * 8 byte header "MMUB" 0x01 0 0 0, then one LEB128 varint per reference
+ * holding (zigzag(page - previous page) << 1) | rw
+ */
+const char trace_magic[8] = { 'M', 'M', 'U', 'B', 1, 0, 0, 0 };
+
+inline unsigned int zigzag_encode(int d) {
+  return ((unsigned int)d << 1) ^ (unsigned int)(d >> 31);
+}
+
+inline int zigzag_decode(unsigned int z) {
+  return (int)(z >> 1) ^ -(int)(z & 1);
+}
+
+// appends the varint of one reference, prev is the previous page
+inline void put_reference(std::vector<unsigned char>& buf, unsigned int& prev,
+                          unsigned int rw, unsigned int pi) {
+  unsigned int v = (zigzag_encode(pi - prev) << 1) | (rw & 1);
+  prev = pi;
+  while (v >= 0x80) {
+    buf.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  buf.push_back(v);
+}
+
+#endif
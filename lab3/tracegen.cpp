@@ -0,0 +1,234 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "trace_format.h"
+
+using namespace std;
+
+/*
+ * synthetic traces for mmu, in its text format or in the binary format
+ * of trace_format.h (same as mmu -b)
+ */
+
+// xorshift64*, fast enough for 10^9 references
+class Random {
+  private:
+    unsigned long long s;
+
+  public:
+    Random(unsigned long long seed) {
+      s = seed * 0x9e3779b97f4a7c15ULL + 1;
+    }
+
+    unsigned long long next() {
+      s ^= s >> 12;
+      s ^= s << 25;
+      s ^= s >> 27;
+      return s * 0x2545f4914f6cdd1dULL;
+    }
+
+    // uniform in [0, 1)
+    double uniform() {
+      return (next() >> 11) * (1.0 / (1ULL << 53));
+    }
+
+    int below(int n) {
+      return (int)((next() >> 33) % n);
+    }
+};
+
+/*
+ * page of rank r (1 the most popular) drawn with probability
+ * proportional to 1 / r^alpha. The ranks are shuffled over the pages.
+ */
+class Zipf {
+  private:
+    vector<double> cdf;
+    vector<int> page_of_rank;
+
+  public:
+    Zipf(int num_of_pages, double alpha, Random& rnd) {
+      double sum = 0;
+      for (int r = 1; r <= num_of_pages; ++r) {
+        sum += 1.0 / pow(r, alpha);
+        cdf.push_back(sum);
+      }
+      for (int r = 0; r < num_of_pages; ++r) {
+        cdf[r] /= sum;
+        page_of_rank.push_back(r);
+      }
+      for (int r = num_of_pages - 1; r > 0; --r) {
+        swap(page_of_rank[r], page_of_rank[rnd.below(r + 1)]);
+      }
+    }
+
+    int next(Random& rnd) {
+      int r = upper_bound(cdf.begin(), cdf.end(), rnd.uniform()) -
+              cdf.begin();
+      return page_of_rank[min(r, (int)cdf.size() - 1)];
+    }
+};
+
+class Writer {
+  private:
+    FILE* file;
+    bool binary;
+    vector<unsigned char> buf;
+    unsigned int prev;
+
+    void flush() {
+      fwrite(&buf[0], 1, buf.size(), file);
+      buf.clear();
+    }
+
+  public:
+    Writer(FILE* f, bool b) {
+      file = f;
+      binary = b;
+      prev = 0;
+      if (binary) {
+        buf.insert(buf.end(), trace_magic, trace_magic + sizeof(trace_magic));
+      }
+    }
+
+    // closes the file
+    ~Writer() {
+      flush();
+      fclose(file);
+    }
+
+    void comment(const char* s) {
+      if (!binary) {
+        buf.insert(buf.end(), s, s + strlen(s));
+      }
+    }
+
+    void add(unsigned int rw, unsigned int pi) {
+      if (binary) {
+        put_reference(buf, prev, rw, pi);
+      }
+      else {
+        buf.push_back('0' + rw);
+        buf.push_back(' ');
+        if (pi >= 10) {
+          buf.push_back('0' + pi / 10);
+        }
+        buf.push_back('0' + pi % 10);
+        buf.push_back('\n');
+      }
+      if (buf.size() >= (1 << 20)) {
+        flush();
+      }
+    }
+};
+
+void usage() {
+  fprintf(stderr,
+    "usage: tracegen [-m<model>] [-n<refs>] [-p<pages>] [-w<write %%>] "
+    "[-s<seed>] [-b] outfile\n"
+    "  models: z[<alpha>]   zipf (default 1)\n"
+    "          l[<length>]  loop over the first length pages (default 3/4)\n"
+    "          s            sequential scan over all pages\n"
+    "          p[<period>]  zipf whose hot pages shift every period refs\n"
+    "          m[<scan %%>]  zipf mixed with a scan (default 20%%)\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[]) {
+  char model = 'z';
+  double param = -1;
+  long long num_of_refs = 1000000;
+  int num_of_pages = 64;
+  double write_share = 0.25;
+  unsigned long long seed = 1;
+  bool binary = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "m:n:p:w:s:b")) != -1) {
+    switch (c) {
+      case 'm':
+        model = optarg[0];
+        if (optarg[1] != '\0') {
+          param = atof(optarg + 1);
+        }
+        break;
+      case 'n':
+        num_of_refs = (long long)atof(optarg);
+        break;
+      case 'p':
+        num_of_pages = atoi(optarg);
+        break;
+      case 'w':
+        write_share = atof(optarg) / 100;
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'b':
+        binary = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc - 1 || strchr("zlspm", model) == NULL ||
+      num_of_pages < 1 || num_of_pages > 64 || num_of_refs < 0) {
+    usage();
+  }
+
+  FILE* file = fopen(argv[optind], binary ? "wb" : "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open output file\n");
+    return 1;
+  }
+
+  Random rnd(seed);
+  Zipf zipf(num_of_pages, model == 'z' && param >= 0 ? param : 1.0, rnd);
+  int loop = model == 'l' && param >= 1 ?
+             min((int)param, num_of_pages) : max(num_of_pages * 3 / 4, 1);
+  long long period = model == 'p' && param >= 1 ?
+                     (long long)param : max(num_of_refs / 8, 1LL);
+  double scan_share = model == 'm' && param >= 0 ? param / 100 : 0.2;
+
+  Writer out(file, binary);
+  char header[200];
+  snprintf(header, sizeof(header),
+           "#tracegen model=%c refs=%lld pages=%d write=%.2lf seed=%llu\n",
+           model, num_of_refs, num_of_pages, write_share, seed);
+  out.comment(header);
+
+  int scan = 0;
+  for (long long t = 0; t < num_of_refs; ++t) {
+    int pi;
+    switch (model) {
+      case 'z':
+        pi = zipf.next(rnd);
+        break;
+      case 'l':
+        pi = t % loop;
+        break;
+      case 's':
+        pi = t % num_of_pages;
+        break;
+      case 'p':
+        // a quarter of the pages further every phase
+        pi = (zipf.next(rnd) + t / period * max(num_of_pages / 4, 1)) %
+             num_of_pages;
+        break;
+      default:
+        if (rnd.uniform() < scan_share) {
+          pi = scan;
+          scan = (scan + 1) % num_of_pages;
+        }
+        else {
+          pi = zipf.next(rnd);
+        }
+    }
+    out.add(rnd.uniform() < write_share, pi);
+  }
+  return 0;
+}
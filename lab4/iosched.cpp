@@ -2,8 +2,12 @@
 #include <cstdio>
 #include <cstdlib>
 #include <vector>
+#include <deque>
+#include <set>
+#include <climits>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
 
 #include <unistd.h>
 #include <string>
@@ -18,48 +22,265 @@ class IOrequest {
     int loc;
     // id 
     int id;
+    // blocks to transfer
+    int size;
 
-    IOrequest(int ti, int loci, int idi) {
+    IOrequest(int ti, int loci, int idi, int sizei = 1) {
       time = ti;
       loc = loci;
       id = idi;
+      size = sizei;
     }
 };
 
 
+/*
+ * pulls requests out of the input file one at a time, as the simulation
+ * reaches them, so memory does not grow with the length of the trace.
+ */
+class RequestReader {
+  private:
+    FILE* file;
+    char buf[500];
+    int t, l, sz;
+    int id;
+    bool has_next;
+    IOrequest next_req;
+
+    void advance() {
+      has_next = false;
+      while (!has_next && fgets(buf, sizeof(buf), file) != NULL &&
+             !feof(file)) {
+        if (buf[0] != '#') {
+          // the size column is optional
+          int k = sscanf(buf, "%d%d%d", &t, &l, &sz);
+          if (k >= 1 && k < 3) {
+            sz = 1;
+          }
+          next_req = IOrequest(t, l, id++, sz);
+          has_next = true;
+        }
+      }
+    }
+
+  public:
+    RequestReader(FILE* f) : next_req(0, 0, 0) {
+      file = f;
+      t = 0;
+      l = 0;
+      sz = 1;
+      id = 0;
+      advance();
+    }
+
+    bool empty() {
+      return !has_next;
+    }
+
+    const IOrequest& peek() {
+      return next_req;
+    }
+
+    IOrequest next() {
+      IOrequest r = next_req;
+      advance();
+      return r;
+    }
+};
+
+/*
+ * how long the device takes to serve a request. The default counts one
+ * time unit per track moved, with no rotation or transfer cost.
+ */
+class Device {
+  private:
+    // what rounding left out of the service times so far
+    double carry;
+
+  public:
+    Device() {
+      carry = 0;
+    }
+
+    virtual ~Device() {}
+
+    // head movement from curr to loc, in the unit of the device
+    virtual int distance(int curr, int loc) {
+      return abs(curr - loc);
+    }
+
+    // time from issue until the head is over the data
+    virtual double access_time(const IOrequest& t, int curr, int now) = 0;
+
+    virtual double transfer_time(const IOrequest& t) {
+      return 0;
+    }
+
+    // in whole time units, the rounding carried over to the next request
+    // so that fractions of a unit still add up
+    int service_time(const IOrequest& t, int curr, int now) {
+      double x = access_time(t, curr, now) + transfer_time(t) + carry;
+      int s = (int)floor(x + 0.5);
+      carry = x - s;
+      return s;
+    }
+};
+
+
+class Device_Track: public Device {
+  public:
+    double access_time(const IOrequest& t, int curr, int now) {
+      return abs(curr - t.loc);
+    }
+};
+
+
+/*
+ * a spinning disk. loc is a block: track loc / spt, sector loc % spt.
+ * A seek of d tracks costs settle + a * sqrt(d) while the arm is still
+ * accelerating (d < knee) and grows linearly by b per track after that.
+ * The platter turns once every rotation time units from angle 0 at time
+ * 0, and a block passes under the head in rotation / spt.
+ */
+class Device_Disk: public Device {
+  private:
+    double rotation;
+    int spt;
+    double settle;
+    double a;
+    double b;
+    double knee;
+
+  public:
+    Device_Disk(double rot, int s, double se, double sa, double lb,
+                double kn) {
+      rotation = rot;
+      spt = s;
+      settle = se;
+      a = sa;
+      b = lb;
+      knee = kn;
+    }
+
+    double seek_time(int d) {
+      if (d == 0) {
+        return 0;
+      }
+      if (d < knee) {
+        return settle + a * sqrt((double)d);
+      }
+      return settle + a * sqrt(knee) + b * (d - knee);
+    }
+
+    // in tracks
+    int distance(int curr, int loc) {
+      return abs(curr / spt - loc / spt);
+    }
+
+    double access_time(const IOrequest& t, int curr, int now) {
+      double seek = seek_time(distance(curr, t.loc));
+      // sector under the head once the arm has settled
+      double head = fmod(now + seek, rotation) / rotation * spt;
+      double sectors = fmod(t.loc % spt - head + spt, (double)spt);
+      return seek + sectors / spt * rotation;
+    }
+
+    double transfer_time(const IOrequest& t) {
+      return t.size * rotation / spt;
+    }
+};
+
+
+// flash: no positioning cost beyond a fixed latency
+class Device_SSD: public Device {
+  private:
+    double latency;
+    double xfer;
+
+  public:
+    Device_SSD(double lat, double x) {
+      latency = lat;
+      xfer = x;
+    }
+
+    // there is no head
+    int distance(int curr, int loc) {
+      return 0;
+    }
+
+    double access_time(const IOrequest& t, int curr, int now) {
+      return latency;
+    }
+
+    double transfer_time(const IOrequest& t) {
+      return t.size * xfer;
+    }
+};
+
+Device* new_device(const char* arg) {
+  double p[6] = { -1, -1, -1, -1, -1, -1 };
+  if (arg[0] != '\0' && arg[1] == ':') {
+    sscanf(arg + 2, "%lf:%lf:%lf:%lf:%lf:%lf",
+           &p[0], &p[1], &p[2], &p[3], &p[4], &p[5]);
+  }
+  switch (arg[0]) {
+    case 't':
+      return new Device_Track();
+    case 'h':
+      return new Device_Disk(p[0] > 0 ? p[0] : 83,
+                             p[1] >= 1 ? (int)p[1] : 8,
+                             p[2] >= 0 ? p[2] : 8,
+                             p[3] >= 0 ? p[3] : 2,
+                             p[4] >= 0 ? p[4] : 0.05,
+                             p[5] >= 1 ? p[5] : 1000);
+    case 's':
+      return new Device_SSD(p[0] >= 0 ? p[0] : 1,
+                            p[1] >= 0 ? p[1] : 0.25);
+  }
+  return NULL;
+}
+
+
 class Scheduler {
   private:
     bool verbose;
 
+  protected:
+    Device* device;
+    // time at which the request asked for by get_next is issued
+    int now;
+
   public:
     Scheduler() {
       verbose = false;
+      device = new Device_Track();
+      now = 0;
     }
 
     void set_verbose() {
       verbose = true;
     }
 
-    void run(vector<IOrequest> instr) {
+    void set_device(Device* d) {
+      delete device;
+      device = d;
+    }
+
+    void run(RequestReader& instr) {
        
       int fin_count = 0;
-      int n = instr.size();
 
-      int tot_movement = 0;
-      int turnaround = 0;
-      int wait_time = 0;
+      long long tot_movement = 0;
+      long long turnaround = 0;
+      long long wait_time = 0;
       int max_wait_time = 0;
-      vector<int> at(n, 0);
-      vector<int> st(n, 0);
-      vector<int> et(n, 0);
+      int issue_time = 0;
       
       int curr = 0;
       int prev = 0;
       
       int sim_time = 0;
 
-      vector<IOrequest> ready;
-
       bool busy = false;
 
       IOrequest t(0, 0, 0);
@@ -68,12 +289,13 @@ class Scheduler {
         printf("TRACE\n");
       }
 
-      while (fin_count != n) {
-        if (!busy && !ready.empty()) {
-          t = this->get_next(ready, curr, (curr - prev >= 0 ? true : false));
+      while (busy || !this->empty() || !instr.empty()) {
+        if (!busy && !this->empty()) {
+          now = sim_time;
+          t = this->get_next(curr, (curr - prev >= 0 ? true : false));
 
           busy = true;
-          tot_movement += abs(curr - t.loc);
+          tot_movement += device->distance(curr, t.loc);
 
           int wt = sim_time - t.time;
           wait_time += wt;
@@ -82,22 +304,22 @@ class Scheduler {
           }
 
           if (verbose) {
-            st[t.id] = sim_time;
+            issue_time = sim_time;
             printf("%d:%6d issue %d %d\n", sim_time, t.id, t.loc, curr);
           }
         }
 
         if (busy) {
-          int fin_time = sim_time + abs(curr - t.loc);
+          int fin_time = sim_time +
+                         device->service_time(t, curr, sim_time);
 
           // check if any instructions ready before current one finishes
-          while (!instr.empty() && instr[0].time <= fin_time) {
-            IOrequest r = this->enqueue(instr, ready, busy);
+          while (!instr.empty() && instr.peek().time <= fin_time) {
+            IOrequest r = this->enqueue(instr, busy);
 
             sim_time = r.time;
 
             if (verbose) {
-              at[r.id] = sim_time;
               printf("%d:%6d add %d\n", sim_time, r.id, r.loc);
             }
           } 
@@ -115,161 +337,230 @@ class Scheduler {
           turnaround += tt;
 
           if (verbose) {
-            et[t.id] = sim_time;
             printf("%d:%6d finish %d\n", sim_time, t.id, tt);
+            // its arrival, start and end time, as it leaves
+            printf("IOREQ %5d:%6d%6d%6d\n", t.id, t.time, issue_time, 
+                   sim_time);
           }
         } 
         else {
-          IOrequest r = this->enqueue(instr, ready, busy);
+          IOrequest r = this->enqueue(instr, busy);
 
           sim_time = r.time;
 
           if (verbose) {
-            at[r.id] = sim_time;
             printf("%d:%6d add %d\n", sim_time, r.id, r.loc);
           }
         }
-        if (this->update(ready)) {
+        if (this->update()) {
           prev = curr;
         }
       }
 
-      if (verbose) {
-        printf("IOREQS INFO\n");
-        for (int i = 0; i < n; ++i) {
-          printf("%5d:%6d%6d%6d\n", i, at[i], st[i], et[i]);
-        }
-      }
-
-      printf("SUM: %d %d %.2lf %.2lf %d\n", sim_time, tot_movement,
+      printf("SUM: %d %lld %.2lf %.2lf %d\n", sim_time, tot_movement,
           (double)turnaround / fin_count, (double)wait_time / fin_count,
           max_wait_time);
     } // end schedule
 
-    virtual bool update(vector<IOrequest>& ready) {
-      return false;
+    IOrequest enqueue(RequestReader& instr, bool busy) {
+      IOrequest t = instr.next();
+      add(t, busy);
+      return t;
     }
 
-    virtual IOrequest enqueue(vector<IOrequest>& instr, 
-                                vector<IOrequest>& ready, bool busy) {
-      IOrequest t = instr.front();
-      instr.erase(instr.begin());
-      ready.push_back(t);
-      return t;
+    // called once per step, true if the scheduler restarted its sweep
+    virtual bool update() {
+      return false;
     }
 
+    // put a new IOrequest into the queue, busy if the disk is working
+    virtual void add(const IOrequest& t, bool busy) = 0;
+
+    virtual bool empty() = 0;
+
     // get the next IOrequest to process according to algo
-    virtual IOrequest get_next(vector<IOrequest>&, int&, bool) = 0;
+    virtual IOrequest get_next(int&, bool) = 0;
 };
 
 
 class Sched_FIFO: public Scheduler {
+  private:
+    deque<IOrequest> ready;
+
   public:
-    IOrequest get_next(vector<IOrequest>& ready, int& curr, bool right) {
+    void add(const IOrequest& t, bool busy) {
+      ready.push_back(t);
+    }
+
+    bool empty() {
+      return ready.empty();
+    }
+
+    IOrequest get_next(int& curr, bool right) {
       IOrequest front = ready.front();
-      ready.erase(ready.begin());
+      ready.pop_front();
       return front;
     }
 };
 
 
-class Sched_SSTF: public Scheduler {
-  public:
-    IOrequest get_next(vector<IOrequest>& ready, int& curr, bool right) {
-      unsigned int dis = 0xffffffff;
-      int next_id = -1;
+struct by_loc {
+  bool operator()(const IOrequest& a, const IOrequest& b) const {
+    return a.loc == b.loc ? a.id < b.id : a.loc < b.loc;
+  }
+};
 
-      for (int i = 0; i < ready.size(); ++i) {
-        int temp = abs(curr - ready[i].loc);
-        if (temp < dis) {
-          dis = temp;
-          next_id = i;
-        }
-      }
-      IOrequest t = ready[next_id];
-      ready.erase(ready.begin() + next_id);
+/*
+ * pending requests ordered by (loc, id), so the next one in either
+ * direction from the head is found and removed in O(log n).
+ */
+class OrderedQueue {
+  private:
+    set<IOrequest, by_loc> reqs;
+
+    IOrequest take(set<IOrequest, by_loc>::iterator it) {
+      IOrequest t = *it;
+      reqs.erase(it);
       return t;
     }
-};
-    
-bool comparator_right(IOrequest a, IOrequest b) {
-  return a.loc == b.loc ? a.id < b.id : a.loc < b.loc;
-}
 
-bool comparator_left(IOrequest a, IOrequest b) {
-  return a.loc == b.loc ? a.id > b.id : a.loc < b.loc;
-}
+  public:
+    bool empty() {
+      return reqs.empty();
+    }
 
+    void insert(const IOrequest& t) {
+      reqs.insert(t);
+    }
 
-class Sched_SCAN: public Scheduler {
-  public:
-    IOrequest get_next(vector<IOrequest>& ready, int& curr, bool right) {
-      int next_id;
+    void swap(OrderedQueue& other) {
+      reqs.swap(other.reqs);
+    }
 
-      if (right) {
-        sort(ready.begin(), ready.end(), comparator_right);
-      } 
-      else {
-        sort(ready.begin(), ready.end(), comparator_left);
+    // lowest id at the nearest loc >= head, else the highest loc and id
+    IOrequest take_right(int head) {
+      set<IOrequest, by_loc>::iterator it =
+          reqs.lower_bound(IOrequest(0, head, INT_MIN));
+      if (it == reqs.end()) {
+        --it;
       }
+      return take(it);
+    }
 
-      if (right) {
-        next_id = ready.size() - 1;
-        
-        for (int i = 0; i < ready.size(); ++i) {
-          if (ready[i].loc >= curr) {
-            next_id = i;
-            break;
-          }
-        }
-      } 
+    // closest to head on either side, the earliest queued on a tie
+    IOrequest take_nearest(int head) {
+      set<IOrequest, by_loc>::iterator up =
+          reqs.lower_bound(IOrequest(0, head, INT_MIN));
+      if (up == reqs.begin()) {
+        return take(up);
+      }
+      set<IOrequest, by_loc>::iterator down = up;
+      --down;
+      down = reqs.lower_bound(IOrequest(0, down->loc, INT_MIN));
+      if (up == reqs.end()) {
+        return take(down);
+      }
+      int d_up = up->loc - head;
+      int d_down = head - down->loc;
+      if (d_down < d_up || (d_down == d_up && down->id < up->id)) {
+        return take(down);
+      }
+      return take(up);
+    }
+
+    // lowest id at the nearest loc <= head, else highest id at lowest loc
+    IOrequest take_left(int head) {
+      set<IOrequest, by_loc>::iterator it =
+          reqs.upper_bound(IOrequest(0, head, INT_MAX));
+      if (it == reqs.begin()) {
+        it = reqs.upper_bound(IOrequest(0, it->loc, INT_MAX));
+        --it;
+      }
       else {
-        next_id = 0;
-        
-        for (int i = ready.size() - 1; i >= 0; --i) {
-          if (ready[i].loc <= curr) {
-            next_id = i;
-            break;
-          }
-        }
+        --it;
+        it = reqs.lower_bound(IOrequest(0, it->loc, INT_MIN));
+      }
+      return take(it);
+    }
+
+    // lowest id at the nearest loc >= head, else wrap to the lowest loc
+    IOrequest take_cyclic(int head) {
+      set<IOrequest, by_loc>::iterator it =
+          reqs.lower_bound(IOrequest(0, head, INT_MIN));
+      if (it == reqs.end()) {
+        it = reqs.begin();
       }
+      return take(it);
+    }
+};
 
-      IOrequest t = ready[next_id];
-      ready.erase(ready.begin() + next_id);
-      return t;
+
+class Sched_SSTF: public Scheduler {
+  private:
+    OrderedQueue ready;
+
+  public:
+    void add(const IOrequest& t, bool busy) {
+      ready.insert(t);
+    }
+
+    bool empty() {
+      return ready.empty();
+    }
+
+    IOrequest get_next(int& curr, bool right) {
+      return ready.take_nearest(curr);
+    }
+};
+
+
+class Sched_SCAN: public Scheduler {
+  private:
+    OrderedQueue ready;
+
+  public:
+    void add(const IOrequest& t, bool busy) {
+      ready.insert(t);
+    }
+
+    bool empty() {
+      return ready.empty();
+    }
+
+    IOrequest get_next(int& curr, bool right) {
+      return right ? ready.take_right(curr) : ready.take_left(curr);
     }
 };
 
 
 class Sched_CSCAN: public Scheduler{
+  private:
+    OrderedQueue ready;
+
   public:
-    IOrequest get_next(vector<IOrequest>& ready, int& curr, bool right) {
-      int next_id = 0;
-      sort(ready.begin(), ready.end(), comparator_right);
+    void add(const IOrequest& t, bool busy) {
+      ready.insert(t);
+    }
 
-      for (int i = 0; i < ready.size(); ++i) {
-        if (ready[i].loc >= curr) {
-          next_id = i;
-          break;
-        }
-      }
+    bool empty() {
+      return ready.empty();
+    }
 
-      IOrequest t = ready[next_id];
-      ready.erase(ready.begin() + next_id);
-      return t;
+    IOrequest get_next(int& curr, bool right) {
+      return ready.take_cyclic(curr);
     }
 };
 
 
 class Sched_FSCAN: public Scheduler {
   private:
-    vector<IOrequest> standby;
+    OrderedQueue ready;
+    OrderedQueue standby;
   
   public:
-    bool update(vector<IOrequest>& ready) {
+    bool update() {
       if (ready.empty()) {
-        ready = standby;
-        standby.clear();
+        ready.swap(standby);
         return true;
       } 
       else {
@@ -277,82 +568,68 @@ class Sched_FSCAN: public Scheduler {
       }
     }
 
-    IOrequest enqueue(vector<IOrequest>& instr, vector<IOrequest>& ready, 
-                        bool busy) {
-
-      IOrequest t = instr.front();
-      instr.erase(instr.begin());
-
+    void add(const IOrequest& t, bool busy) {
       // if not busy put it into the ready queue.
       if (!busy) {
-        ready.push_back(t);
+        ready.insert(t);
       } // else put in standby
       else {
-        standby.push_back(t);
+        standby.insert(t);
       }
-      return t;
     }
 
+    bool empty() {
+      return ready.empty();
+    }
 
-    IOrequest get_next(vector<IOrequest>& ready, int& curr, bool right) {
-      int next_id;
+    IOrequest get_next(int& curr, bool right) {
+      return right ? ready.take_right(curr) : ready.take_left(curr);
+    }
+};
 
-      if (right) {
-        sort(ready.begin(), ready.end(), comparator_right);
-      } 
-      else {
-        sort(ready.begin(), ready.end(), comparator_left);
-      }
+/*
+ * shortest access time first: seek and rotation both count, so every
+ * pending request has to be priced against the current head and angle.
+ */
+class Sched_SATF: public Scheduler {
+  private:
+    vector<IOrequest> ready;
 
-      if (right) {
-        next_id = ready.size() - 1;
-        for (int i = 0; i < ready.size(); ++i) {
-          if (ready[i].loc >= curr) {
-            next_id = i;
-            break;
-          }
-        }
-      } 
-      else {
-        next_id = 0;
-        for (int i = ready.size() - 1; i >= 0; --i) {
-          if (ready[i].loc <= curr) {
-            next_id = i;
-            break;
-          }
+  public:
+    void add(const IOrequest& t, bool busy) {
+      ready.push_back(t);
+    }
+
+    bool empty() {
+      return ready.empty();
+    }
+
+    IOrequest get_next(int& curr, bool right) {
+      double best = 0;
+      int next_id = -1;
+
+      for (int i = 0; i < ready.size(); ++i) {
+        double temp = device->access_time(ready[i], curr, now);
+        if (next_id == -1 || temp < best) {
+          best = temp;
+          next_id = i;
         }
       }
-
       IOrequest t = ready[next_id];
       ready.erase(ready.begin() + next_id);
       return t;
     }
 };
 
-void read_input_file(vector<IOrequest>& instr, FILE** f) {
-  FILE *infile = *f;
-  char buf[500];
-  int t, l;
-  int id = 0;;
-
-  fgets(buf, 500, infile);
-  while (!feof(infile)) {
-    if (buf[0] != '#') {
-      sscanf(buf, "%d%d", &t, &l);
-      instr.push_back(IOrequest(t, l, id++));
-    }
-    fgets(buf, 5000, infile);
-  }
-}
-
 int main(int argc, char* argv[]) {
   
   FILE* infile = NULL;
-  vector<IOrequest> instr;
   Scheduler* sched = new Sched_FIFO();
+  Device* device = NULL;
+  bool verbose = false;
 
   int c;
-  while ((c = getopt(argc, argv, "s:")) != -1) {
+  while ((c = getopt(argc, argv, "s:d:v")) != -1) {
     switch (c) {
        
       case 's':
@@ -371,6 +648,21 @@ int main(int argc, char* argv[]) {
         else if (optarg[0] == 'f') {
           sched = new Sched_FSCAN();
         } 
+        else if (optarg[0] == 'a') {
+          sched = new Sched_SATF();
+        } 
+        break;
+
+      case 'v':
+        verbose = true;
+        break;
+
+      case 'd':
+        device = new_device(optarg);
+        if (device == NULL) {
+          fprintf(stderr, "Unknown device model: %s\n", optarg);
+          abort();
+        }
         break;
     }
   }
@@ -382,8 +674,13 @@ int main(int argc, char* argv[]) {
     abort();
   }
 
-  read_input_file(instr, &infile);
-  //sched->set_verbose();
+  RequestReader instr(infile);
+  if (verbose) {
+    sched->set_verbose();
+  }
+  if (device != NULL) {
+    sched->set_device(device);
+  }
 
   sched->run(instr);
 